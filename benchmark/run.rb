@@ -0,0 +1,146 @@
+# Throughput benchmarks of the hot paths.
+# Each result is printed as one line of JSON so that the results can be compared between commits.
+#
+# Usage: rake bench
+#   BENCH_FILTER=conv   Run only the benchmarks whose name matches the pattern.
+#   BENCH_TIME=1.0      Minimum time in seconds to run each benchmark.
+#   BENCH_OUTPUT=file   Also write the results to the file.
+#   RUBY_DNN_USE_NATIVE=DISABLE  Measure the pure Ruby implementation.
+
+require "dnn"
+require "dnn/image"
+require "json"
+require "tmpdir"
+require "fileutils"
+
+module DNN
+  module Benchmark
+    @benchmarks = []
+
+    # @param [String] name Benchmark name.
+    # @param [Integer] items Number of items processed by one iteration.
+    # @param [String] unit Unit of the items.
+    # @param [Hash] params Parameters of the benchmark such as the shape.
+    # @yield Return the proc that runs one iteration. Setup is done in the block.
+    def self.define(name, items:, unit:, **params, &block)
+      @benchmarks << { name: name, items: items, unit: unit, params: params, setup: block }
+    end
+
+    def self.run(filter: nil, min_time: 1.0, io: $stdout, output: nil)
+      results = []
+      @benchmarks.each do |bench|
+        next if filter && bench[:name] !~ Regexp.new(filter)
+        iteration = bench[:setup].call
+        iteration.call
+        iterations = 0
+        elapsed = 0.0
+        start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        loop do
+          iteration.call
+          iterations += 1
+          elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+          break if elapsed >= min_time && iterations >= 3
+        end
+        result = {
+          name: bench[:name],
+          params: bench[:params],
+          iterations: iterations,
+          seconds: elapsed,
+          ms_per_iteration: elapsed * 1000 / iterations,
+          throughput: bench[:items] * iterations / elapsed,
+          unit: "#{bench[:unit]}/s",
+          native: DNN.use_native?,
+          ruby: RUBY_VERSION,
+          version: DNN::VERSION,
+        }
+        io.puts JSON.generate(result)
+        io.flush
+        results << result
+      end
+      File.write(output, results.map { |result| JSON.generate(result) }.join("\n") + "\n") if output
+      results
+    end
+
+    def self.forward_backward(layer, x)
+      input = Tensor.new(x)
+      lambda do
+        y = layer.(input)
+        y.backward(Xumo::SFloat.ones(*y.shape))
+      end
+    end
+
+    def self.build_layer(layer, x)
+      layer.build(x.shape[1..-1])
+      layer.set_learning_phase(true)
+      layer
+    end
+
+    define("dense", items: 128, unit: "samples", shape: [128, 784], units: 256) do
+      x = Xumo::SFloat.new(128, 784).rand(-1, 1)
+      forward_backward(build_layer(Layers::Dense.new(256), x), x)
+    end
+
+    define("conv2d", items: 32, unit: "samples", shape: [32, 32, 32, 16], filters: 32, filter_size: 3) do
+      x = Xumo::SFloat.new(32, 32, 32, 16).rand(-1, 1)
+      forward_backward(build_layer(Layers::Conv2D.new(32, 3, padding: true), x), x)
+    end
+
+    define("max_pool2d", items: 32, unit: "samples", shape: [32, 32, 32, 32], pool_size: 2) do
+      x = Xumo::SFloat.new(32, 32, 32, 32).rand(-1, 1)
+      forward_backward(build_layer(Layers::MaxPool2D.new(2), x), x)
+    end
+
+    define("avg_pool2d", items: 32, unit: "samples", shape: [32, 32, 32, 32], pool_size: 2) do
+      x = Xumo::SFloat.new(32, 32, 32, 32).rand(-1, 1)
+      forward_backward(build_layer(Layers::AvgPool2D.new(2), x), x)
+    end
+
+    define("lstm", items: 32, unit: "samples", shape: [32, 32, 64], units: 128) do
+      x = Xumo::SFloat.new(32, 32, 64).rand(-1, 1)
+      forward_backward(build_layer(Layers::LSTM.new(128), x), x)
+    end
+
+    define("gru", items: 32, unit: "samples", shape: [32, 32, 64], units: 128) do
+      x = Xumo::SFloat.new(32, 32, 64).rand(-1, 1)
+      forward_backward(build_layer(Layers::GRU.new(128), x), x)
+    end
+
+    { "sgd" => -> { Optimizers::SGD.new(momentum: 0.9) },
+      "adagrad" => -> { Optimizers::AdaGrad.new },
+      "rmsprop" => -> { Optimizers::RMSProp.new },
+      "adam" => -> { Optimizers::Adam.new } }.each do |name, optimizer_new|
+      define("optimizer_#{name}", items: 1_048_576, unit: "params", shapes: [[1024, 768], [256, 1024]]) do
+        optimizer = optimizer_new.()
+        params = [[1024, 768], [256, 1024]].map { |shape| Variable.new(Xumo::SFloat.new(*shape).rand(-1, 1)) }
+        grads = params.map { |param| Xumo::SFloat.new(*param.shape).rand(-1, 1) }
+        lambda do
+          # The optimizer resets the grads after the update.
+          params.each.with_index { |param, i| param.grad = grads[i] }
+          optimizer.update(params)
+        end
+      end
+    end
+
+    define("image_read_batch", items: 32, unit: "images", size: [256, 256], resize: [224, 224]) do
+      dir = Dir.mktmpdir
+      at_exit { FileUtils.remove_entry(dir) }
+      file_names = Array.new(32) do |i|
+        file_name = "#{dir}/#{i}.png"
+        Image.write(file_name, Numo::UInt8.new(256, 256, 3).rand(256))
+        file_name
+      end
+      -> { Image.read_batch(file_names, 224, 224) }
+    end
+
+    define("image_resize", items: 1, unit: "images", size: [512, 512], resize: [224, 224]) do
+      img = Numo::UInt8.new(512, 512, 3).rand(256)
+      -> { Image.resize(img, 224, 224) }
+    end
+  end
+end
+
+if $0 == __FILE__
+  DNN::Benchmark.run(filter: ENV["BENCH_FILTER"],
+                     min_time: (ENV["BENCH_TIME"] || 1.0).to_f,
+                     output: ENV["BENCH_OUTPUT"])
+end
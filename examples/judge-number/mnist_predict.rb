@@ -7,6 +7,7 @@ def load_model
   $model = ConvNet.create([28, 28, 1])
   $model.predict1(Numo::SFloat.zeros(28, 28, 1))
   $model.load_params("trained_mnist_params.marshal")
+  $frozen_model = $model.to_frozen_model
 end
 
 def mnist_predict(img, width, height)
@@ -15,6 +16,6 @@ def mnist_predict(img, width, height)
   img = DNN::Image.to_rgb(img)
   img = DNN::Image.to_gray_scale(img)
   x = Numo::SFloat.cast(img) / 255
-  out = $model.predict1(x)
+  out = $frozen_model.predict1(x)
   out.to_a.map { |v| v.round(4) * 100 }
 end
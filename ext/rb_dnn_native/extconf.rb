@@ -0,0 +1,18 @@
+require "mkmf"
+
+have_library("pthread") unless RUBY_PLATFORM =~ /mswin|mingw/
+$CFLAGS << " -O3"
+
+# The optimizer and inference kernels write Numo::SFloat in place through the Numo C API.
+# They are skipped if the headers of numo-narray are not found.
+unless RUBY_PLATFORM =~ /mswin|mingw/
+  begin
+    require "numo/narray"
+    numo_dir = $LOAD_PATH.map { |lp| File.join(lp, "numo") }.find { |dir| File.exist?(File.join(dir, "numo/narray.h")) }
+    $INCFLAGS = "-I#{numo_dir} #{$INCFLAGS}" if numo_dir
+  rescue LoadError
+  end
+  have_header("numo/narray.h")
+end
+
+create_makefile("rb_dnn_native")
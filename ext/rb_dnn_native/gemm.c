@@ -0,0 +1,75 @@
+#include "rb_dnn_native.h"
+#include <string.h>
+
+typedef struct {
+  int trans_a, trans_b;
+  long n, k;
+  const float* a;
+  long lda;
+  const float* b;
+  long ldb;
+  float beta;
+  float* c;
+  long ldc;
+} sgemm_args_t;
+
+#define SGEMM_A(args, i, p) ((args)->trans_a ? (args)->a[(p) * (args)->lda + (i)] : (args)->a[(i) * (args)->lda + (p)])
+
+static void sgemm_rows(void* ptr, long begin, long end) {
+  sgemm_args_t* args = (sgemm_args_t*)ptr;
+  const long n = args->n;
+  const long k = args->k;
+  long i, j, p;
+
+  for (i = begin; i < end; i++) {
+    float* c_row = args->c + i * args->ldc;
+
+    if (args->beta == 0.0f) {
+      memset(c_row, 0, sizeof(float) * n);
+    } else if (args->beta != 1.0f) {
+      for (j = 0; j < n; j++) c_row[j] *= args->beta;
+    }
+    if (!args->trans_b) {
+      // Accumulate rows of B so the innermost loop runs over contiguous memory.
+      for (p = 0; p < k; p++) {
+        const float a_ip = SGEMM_A(args, i, p);
+        const float* b_row = args->b + p * args->ldb;
+        for (j = 0; j < n; j++) c_row[j] += a_ip * b_row[j];
+      }
+    } else {
+      for (j = 0; j < n; j++) {
+        const float* b_row = args->b + j * args->ldb;
+        float sum = 0.0f;
+        if (!args->trans_a) {
+          const float* a_row = args->a + i * args->lda;
+          for (p = 0; p < k; p++) sum += a_row[p] * b_row[p];
+        } else {
+          for (p = 0; p < k; p++) sum += SGEMM_A(args, i, p) * b_row[p];
+        }
+        c_row[j] += sum;
+      }
+    }
+  }
+}
+
+void dnn_sgemm(int trans_a, int trans_b, long m, long n, long k,
+               const float* a, long lda, const float* b, long ldb, float beta, float* c, long ldc) {
+  sgemm_args_t args;
+  long min_rows;
+
+  if (m <= 0 || n <= 0) return;
+  args.trans_a = trans_a;
+  args.trans_b = trans_b;
+  args.n = n;
+  args.k = k;
+  args.a = a;
+  args.lda = lda;
+  args.b = b;
+  args.ldb = ldb;
+  args.beta = beta;
+  args.c = c;
+  args.ldc = ldc;
+  // Keep small products on the calling thread; starting threads would cost more than the work.
+  min_rows = 65536 / (n * (k > 0 ? k : 1)) + 1;
+  dnn_parallel_for(m, min_rows, sgemm_rows, &args);
+}
@@ -0,0 +1,217 @@
+#include "rb_dnn_native.h"
+#include <string.h>
+
+// Geometry shared by im2col and col2im. The image is NHWC and the column matrix is
+// [bsize, out_h, out_w, fil_h, fil_w, ch]. Padding is split like Conv2DUtils#zero_padding.
+typedef struct {
+  float* img;
+  float* col;
+  int32_t bsize, img_h, img_w, ch;
+  int32_t out_h, out_w;
+  int32_t fil_h, fil_w;
+  int32_t stride_h, stride_w;
+  int32_t pad_top, pad_left;
+} conv_args_t;
+
+static void conv_args_set(conv_args_t* args, const int32_t img_shape[4], const int32_t out_size[2],
+                          const int32_t filter_size[2], const int32_t strides[2], const int32_t pad[2]) {
+  args->bsize = img_shape[0];
+  args->img_h = img_shape[1];
+  args->img_w = img_shape[2];
+  args->ch = img_shape[3];
+  args->out_h = out_size[0];
+  args->out_w = out_size[1];
+  args->fil_h = filter_size[0];
+  args->fil_w = filter_size[1];
+  args->stride_h = strides[0];
+  args->stride_w = strides[1];
+  args->pad_top = pad[0] / 2;
+  args->pad_left = pad[1] / 2;
+}
+
+static void conv_args_init(conv_args_t* args, VALUE rb_img_shape, VALUE rb_out_size, VALUE rb_filter_size,
+                           VALUE rb_strides, VALUE rb_pad) {
+  int32_t img_shape[4], out_size[2], filter_size[2], strides[2], pad[2];
+  int i;
+
+  for (i = 0; i < 4; i++) img_shape[i] = dnn_ary_int(rb_img_shape, i);
+  for (i = 0; i < 2; i++) {
+    out_size[i] = dnn_ary_int(rb_out_size, i);
+    filter_size[i] = dnn_ary_int(rb_filter_size, i);
+    strides[i] = dnn_ary_int(rb_strides, i);
+    pad[i] = dnn_ary_int(rb_pad, i);
+  }
+  if (strides[0] < 1 || strides[1] < 1) rb_raise(rb_eArgError, "strides must be 1 or more.");
+  conv_args_set(args, img_shape, out_size, filter_size, strides, pad);
+}
+
+static long conv_img_size(conv_args_t* args) {
+  return (long)args->bsize * args->img_h * args->img_w * args->ch;
+}
+
+static long conv_col_size(conv_args_t* args) {
+  return (long)args->bsize * args->out_h * args->out_w * args->fil_h * args->fil_w * args->ch;
+}
+
+// Range of kx for which the input column ix0 + kx lies inside the image.
+static void conv_valid_kx(conv_args_t* args, int32_t ix0, int32_t* kx_begin, int32_t* kx_end) {
+  *kx_begin = ix0 < 0 ? -ix0 : 0;
+  *kx_end = args->img_w - ix0 < args->fil_w ? args->img_w - ix0 : args->fil_w;
+  if (*kx_end < *kx_begin) *kx_end = *kx_begin;
+}
+
+// Number of floats of the column matrix written by one tile of im2col. 8192 floats (32KB) keep the tile
+// in L1/L2 cache while it is filled.
+#define DNN_IM2COL_BLOCK_FLOATS 8192
+
+// Number of output columns of one tile. At least one column is processed even if it exceeds the block.
+static int32_t conv_block_out_w(conv_args_t* args) {
+  const long col_len = (long)args->fil_h * args->fil_w * args->ch;
+  long block = col_len > 0 ? DNN_IM2COL_BLOCK_FLOATS / col_len : args->out_w;
+
+  if (block < 1) block = 1;
+  if (block > args->out_w) block = args->out_w;
+  return (int32_t)block;
+}
+
+// One item is one output row (b, oy). The row is split into tiles of output columns. Within a tile,
+// ky is the outer loop, so the overlapping windows read the same input row while it is in cache
+// and the writes stay inside the cache-sized tile of the column matrix.
+static void im2col_rows(void* ptr, long begin, long end) {
+  conv_args_t* args = (conv_args_t*)ptr;
+  const long row_len = (long)args->fil_w * args->ch;
+  const long ch = args->ch;
+  const int32_t block = conv_block_out_w(args);
+  long item;
+
+  for (item = begin; item < end; item++) {
+    const int32_t b = (int32_t)(item / args->out_h);
+    const int32_t oy = (int32_t)(item % args->out_h);
+    const float* img_b = args->img + (long)b * args->img_h * args->img_w * ch;
+    float* col_row = args->col + item * args->out_w * args->fil_h * row_len;
+    int32_t ox0, ox, ky;
+
+    for (ox0 = 0; ox0 < args->out_w; ox0 += block) {
+      const int32_t ox1 = ox0 + block < args->out_w ? ox0 + block : args->out_w;
+
+      for (ky = 0; ky < args->fil_h; ky++) {
+        const int32_t iy = oy * args->stride_h + ky - args->pad_top;
+        const int32_t iy_valid = iy >= 0 && iy < args->img_h;
+        const float* src_row = iy_valid ? img_b + (long)iy * args->img_w * ch : NULL;
+
+        for (ox = ox0; ox < ox1; ox++) {
+          const int32_t ix0 = ox * args->stride_w - args->pad_left;
+          float* dest = col_row + ((long)ox * args->fil_h + ky) * row_len;
+          int32_t kx_begin, kx_end;
+
+          conv_valid_kx(args, ix0, &kx_begin, &kx_end);
+          if (!iy_valid || kx_begin == kx_end) {
+            memset(dest, 0, sizeof(float) * row_len);
+            continue;
+          }
+          if (kx_begin > 0) memset(dest, 0, sizeof(float) * kx_begin * ch);
+          memcpy(dest + kx_begin * ch, src_row + (ix0 + kx_begin) * ch, sizeof(float) * (kx_end - kx_begin) * ch);
+          if (kx_end < args->fil_w) {
+            memset(dest + kx_end * ch, 0, sizeof(float) * (args->fil_w - kx_end) * ch);
+          }
+        }
+      }
+    }
+  }
+}
+
+// One item is one input row (b, iy). Each task gathers every column entry that overlaps its
+// row, so no two threads write the same pixel and the result does not depend on scheduling.
+// The destination row is the block that stays in cache, so col2im is not tiled further.
+static void col2im_rows(void* ptr, long begin, long end) {
+  conv_args_t* args = (conv_args_t*)ptr;
+  const long row_len = (long)args->fil_w * args->ch;
+  const long ch = args->ch;
+  long item;
+
+  for (item = begin; item < end; item++) {
+    const int32_t b = (int32_t)(item / args->img_h);
+    const int32_t iy = (int32_t)(item % args->img_h);
+    float* dest_row = args->img + item * args->img_w * ch;
+    const float* col_b = args->col + (long)b * args->out_h * args->out_w * args->fil_h * row_len;
+    int32_t oy, ox;
+
+    memset(dest_row, 0, sizeof(float) * args->img_w * ch);
+    for (oy = 0; oy < args->out_h; oy++) {
+      const int32_t ky = iy + args->pad_top - oy * args->stride_h;
+      if (ky < 0 || ky >= args->fil_h) continue;
+      for (ox = 0; ox < args->out_w; ox++) {
+        const int32_t ix0 = ox * args->stride_w - args->pad_left;
+        const float* src = col_b + (((long)oy * args->out_w + ox) * args->fil_h + ky) * row_len;
+        int32_t kx_begin, kx_end;
+        float* dest;
+        long i, len;
+
+        conv_valid_kx(args, ix0, &kx_begin, &kx_end);
+        dest = dest_row + (long)(ix0 + kx_begin) * ch;
+        src += (long)kx_begin * ch;
+        len = (long)(kx_end - kx_begin) * ch;
+        for (i = 0; i < len; i++) {
+          dest[i] += src[i];
+        }
+      }
+    }
+  }
+}
+
+static void* im2col_without_gvl(void* ptr) {
+  conv_args_t* args = (conv_args_t*)ptr;
+  dnn_parallel_for((long)args->bsize * args->out_h, 1, im2col_rows, args);
+  return NULL;
+}
+
+static void* col2im_without_gvl(void* ptr) {
+  conv_args_t* args = (conv_args_t*)ptr;
+  dnn_parallel_for((long)args->bsize * args->img_h, 1, col2im_rows, args);
+  return NULL;
+}
+
+void dnn_im2col(const float* img, float* col, const int32_t img_shape[4], const int32_t out_size[2],
+                const int32_t filter_size[2], const int32_t strides[2], const int32_t pad[2]) {
+  conv_args_t args;
+
+  conv_args_set(&args, img_shape, out_size, filter_size, strides, pad);
+  args.img = (float*)img;
+  args.col = col;
+  im2col_without_gvl(&args);
+}
+
+// img[bsize, img_h, img_w, ch] to col[bsize * out_h * out_w, fil_h * fil_w * ch]
+static VALUE rb_im2col(VALUE self, VALUE rb_img, VALUE rb_img_shape, VALUE rb_out_size, VALUE rb_filter_size,
+                       VALUE rb_strides, VALUE rb_pad) {
+  conv_args_t args;
+  VALUE rb_col;
+
+  conv_args_init(&args, rb_img_shape, rb_out_size, rb_filter_size, rb_strides, rb_pad);
+  args.img = dnn_sfloat_ptr(rb_img, conv_img_size(&args));
+  rb_col = rb_str_new(NULL, conv_col_size(&args) * sizeof(float));
+  args.col = (float*)RSTRING_PTR(rb_col);
+  dnn_call_without_gvl(im2col_without_gvl, &args);
+  RB_GC_GUARD(rb_img);
+  return rb_col;
+}
+
+// col[bsize * out_h * out_w, fil_h * fil_w * ch] to img[bsize, img_h, img_w, ch]
+static VALUE rb_col2im(VALUE self, VALUE rb_col, VALUE rb_img_shape, VALUE rb_out_size, VALUE rb_filter_size,
+                       VALUE rb_strides, VALUE rb_pad) {
+  conv_args_t args;
+  VALUE rb_img;
+
+  conv_args_init(&args, rb_img_shape, rb_out_size, rb_filter_size, rb_strides, rb_pad);
+  args.col = dnn_sfloat_ptr(rb_col, conv_col_size(&args));
+  rb_img = rb_str_new(NULL, conv_img_size(&args) * sizeof(float));
+  args.img = (float*)RSTRING_PTR(rb_img);
+  dnn_call_without_gvl(col2im_without_gvl, &args);
+  RB_GC_GUARD(rb_col);
+  return rb_img;
+}
+
+void Init_dnn_im2col(VALUE rb_native) {
+  rb_define_module_function(rb_native, "im2col", rb_im2col, 6);
+  rb_define_module_function(rb_native, "col2im", rb_col2im, 6);
+}
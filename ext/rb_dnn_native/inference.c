@@ -0,0 +1,239 @@
+#include "rb_dnn_native.h"
+
+#ifdef HAVE_NUMO_NARRAY_H
+#include <math.h>
+#include <numo/narray.h>
+
+// Forward kernels of FrozenModel. They write into preallocated Numo::SFloat buffers and apply
+// the fused epilogue out = act(out * scale + bias) in one pass over the output, where scale and
+// bias are broadcast over the trailing elements of every sample.
+#define EPILOGUE_MIN_CHUNK 4096
+
+enum {
+  ACT_NONE,
+  ACT_RELU,
+  ACT_SIGMOID,
+  ACT_TANH
+};
+
+typedef struct {
+  const float* src;
+  float* dest;
+  long size;
+  const float* scale;
+  long scale_size;
+  const float* bias;
+  long bias_size;
+  int act;
+} epilogue_args_t;
+
+// out[rows, cols] = in[rows, depth].dot(weight[depth, cols]), where in is x or its im2col.
+typedef struct {
+  long rows, depth, cols;
+  const float* x;
+  const float* weight;
+  float* col;
+  float* out;
+  int im2col;
+  int32_t img_shape[4], out_size[2], filter_size[2], strides[2], pad[2];
+  epilogue_args_t epilogue;
+} forward_args_t;
+
+static int inference_act(VALUE rb_act) {
+  ID id;
+
+  if (NIL_P(rb_act)) return ACT_NONE;
+  Check_Type(rb_act, T_SYMBOL);
+  id = SYM2ID(rb_act);
+  if (id == rb_intern("relu")) return ACT_RELU;
+  if (id == rb_intern("sigmoid")) return ACT_SIGMOID;
+  if (id == rb_intern("tanh")) return ACT_TANH;
+  rb_raise(rb_eArgError, "Activation %"PRIsVALUE" is not supported.", rb_act);
+  return ACT_NONE;
+}
+
+// scale and bias are nil or Numo::SFloat whose size divides the output size.
+static void epilogue_args_init(epilogue_args_t* args, VALUE rb_scale, VALUE rb_bias, VALUE rb_act,
+                               float* dest, long size) {
+  args->src = dest;
+  args->dest = dest;
+  args->size = size;
+  args->scale = NULL;
+  args->scale_size = 1;
+  args->bias = NULL;
+  args->bias_size = 1;
+  args->act = inference_act(rb_act);
+  if (!NIL_P(rb_scale)) args->scale = dnn_narray_sfloat_ptr_for_read(rb_scale, &args->scale_size);
+  if (!NIL_P(rb_bias)) args->bias = dnn_narray_sfloat_ptr_for_read(rb_bias, &args->bias_size);
+  if (args->scale_size < 1 || size % args->scale_size != 0) {
+    rb_raise(rb_eArgError, "The size of scale does not match the output.");
+  }
+  if (args->bias_size < 1 || size % args->bias_size != 0) {
+    rb_raise(rb_eArgError, "The size of bias does not match the output.");
+  }
+}
+
+static void epilogue_range(void* ptr, long begin, long end) {
+  epilogue_args_t* args = (epilogue_args_t*)ptr;
+  long i, s = begin % args->scale_size, b = begin % args->bias_size;
+
+  for (i = begin; i < end; i++) {
+    float v = args->src[i];
+    if (args->scale) v *= args->scale[s];
+    if (args->bias) v += args->bias[b];
+    switch (args->act) {
+    case ACT_RELU:
+      if (v < 0) v = 0;
+      break;
+    case ACT_SIGMOID:
+      v = 1.0f / (1.0f + expf(-v));
+      break;
+    case ACT_TANH:
+      v = tanhf(v);
+      break;
+    }
+    args->dest[i] = v;
+    if (++s == args->scale_size) s = 0;
+    if (++b == args->bias_size) b = 0;
+  }
+}
+
+static void* epilogue_without_gvl(void* ptr) {
+  epilogue_args_t* args = (epilogue_args_t*)ptr;
+  if (!args->scale && !args->bias && args->act == ACT_NONE && args->src == args->dest) return NULL;
+  dnn_parallel_for(args->size, EPILOGUE_MIN_CHUNK, epilogue_range, args);
+  return NULL;
+}
+
+static void* forward_without_gvl(void* ptr) {
+  forward_args_t* args = (forward_args_t*)ptr;
+  const float* in = args->x;
+
+  if (args->im2col) {
+    dnn_im2col(args->x, args->col, args->img_shape, args->out_size, args->filter_size, args->strides, args->pad);
+    in = args->col;
+  }
+  dnn_sgemm(0, 0, args->rows, args->cols, args->depth, in, args->depth, args->weight, args->cols,
+            0.0f, args->out, args->cols);
+  return epilogue_without_gvl(&args->epilogue);
+}
+
+static long inference_dim(VALUE rb_ary, long index) {
+  long dim = dnn_ary_int(rb_ary, index);
+  if (dim < 1) rb_raise(rb_eArgError, "dims must be positive.");
+  return dim;
+}
+
+static void check_size(long actual, long expected, const char* name) {
+  if (actual != expected) rb_raise(rb_eArgError, "The size of %s is %ld, but expected %ld.", name, actual, expected);
+}
+
+/*
+  Native.dense_forward(x, weight, scale, bias, act, out, dims)
+  out[batch, units] = act(x[batch, in].dot(weight) * scale + bias), where dims is [batch, in, units].
+  scale and bias may be nil, and act is nil, :relu, :sigmoid or :tanh.
+*/
+static VALUE rb_dense_forward(VALUE self, VALUE rb_x, VALUE rb_weight, VALUE rb_scale, VALUE rb_bias,
+                              VALUE rb_act, VALUE rb_out, VALUE rb_dims) {
+  forward_args_t args;
+  long x_size, weight_size, out_size;
+
+  args.rows = inference_dim(rb_dims, 0);
+  args.depth = inference_dim(rb_dims, 1);
+  args.cols = inference_dim(rb_dims, 2);
+  args.x = dnn_narray_sfloat_ptr_for_read(rb_x, &x_size);
+  args.weight = dnn_narray_sfloat_ptr_for_read(rb_weight, &weight_size);
+  args.out = dnn_narray_sfloat_ptr(rb_out, &out_size);
+  check_size(x_size, args.rows * args.depth, "x");
+  check_size(weight_size, args.depth * args.cols, "weight");
+  check_size(out_size, args.rows * args.cols, "out");
+  args.col = NULL;
+  args.im2col = 0;
+  epilogue_args_init(&args.epilogue, rb_scale, rb_bias, rb_act, args.out, out_size);
+  dnn_call_without_gvl(forward_without_gvl, &args);
+  RB_GC_GUARD(rb_x);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_scale);
+  RB_GC_GUARD(rb_bias);
+  return rb_out;
+}
+
+/*
+  Native.conv2d_forward(x, weight, scale, bias, act, col, out, img_shape, out_size, filter_size, strides, pad)
+  NHWC convolution of x[img_shape] with weight[fil_h * fil_w * ch, num_filters] into
+  out[bsize, out_h, out_w, num_filters] followed by the epilogue. col is the scratch buffer of
+  im2col, and it is not used for 1x1 convolutions with stride 1 and no padding.
+*/
+static VALUE rb_conv2d_forward(VALUE self, VALUE rb_x, VALUE rb_weight, VALUE rb_scale, VALUE rb_bias, VALUE rb_act,
+                               VALUE rb_col, VALUE rb_out, VALUE rb_img_shape, VALUE rb_out_size,
+                               VALUE rb_filter_size, VALUE rb_strides, VALUE rb_pad) {
+  forward_args_t args;
+  long x_size, weight_size, col_size, out_size;
+  int i;
+
+  for (i = 0; i < 4; i++) args.img_shape[i] = (int32_t)inference_dim(rb_img_shape, i);
+  for (i = 0; i < 2; i++) {
+    args.out_size[i] = (int32_t)inference_dim(rb_out_size, i);
+    args.filter_size[i] = (int32_t)inference_dim(rb_filter_size, i);
+    args.strides[i] = (int32_t)inference_dim(rb_strides, i);
+    args.pad[i] = dnn_ary_int(rb_pad, i);
+  }
+  args.rows = (long)args.img_shape[0] * args.out_size[0] * args.out_size[1];
+  args.depth = (long)args.filter_size[0] * args.filter_size[1] * args.img_shape[3];
+  args.x = dnn_narray_sfloat_ptr_for_read(rb_x, &x_size);
+  args.weight = dnn_narray_sfloat_ptr_for_read(rb_weight, &weight_size);
+  args.out = dnn_narray_sfloat_ptr(rb_out, &out_size);
+  check_size(x_size, (long)args.img_shape[0] * args.img_shape[1] * args.img_shape[2] * args.img_shape[3], "x");
+  if (weight_size % args.depth != 0) rb_raise(rb_eArgError, "The size of weight does not match the filter.");
+  args.cols = weight_size / args.depth;
+  check_size(out_size, args.rows * args.cols, "out");
+  args.im2col = !(args.filter_size[0] == 1 && args.filter_size[1] == 1 && args.strides[0] == 1 &&
+                  args.strides[1] == 1 && args.pad[0] == 0 && args.pad[1] == 0);
+  args.col = NULL;
+  if (args.im2col) {
+    args.col = dnn_narray_sfloat_ptr(rb_col, &col_size);
+    if (col_size < args.rows * args.depth) rb_raise(rb_eArgError, "col is too small.");
+  }
+  epilogue_args_init(&args.epilogue, rb_scale, rb_bias, rb_act, args.out, out_size);
+  dnn_call_without_gvl(forward_without_gvl, &args);
+  RB_GC_GUARD(rb_x);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_scale);
+  RB_GC_GUARD(rb_bias);
+  RB_GC_GUARD(rb_col);
+  return rb_out;
+}
+
+/*
+  Native.affine_forward(x, scale, bias, act, out)
+  out = act(x * scale + bias). It is used for a BatchNormalization or an activation that could not be fused.
+*/
+static VALUE rb_affine_forward(VALUE self, VALUE rb_x, VALUE rb_scale, VALUE rb_bias, VALUE rb_act, VALUE rb_out) {
+  epilogue_args_t args;
+  const float* x;
+  long x_size, out_size;
+
+  x = dnn_narray_sfloat_ptr_for_read(rb_x, &x_size);
+  epilogue_args_init(&args, rb_scale, rb_bias, rb_act, dnn_narray_sfloat_ptr(rb_out, &out_size), x_size);
+  check_size(out_size, x_size, "out");
+  args.src = x;
+  dnn_call_without_gvl(epilogue_without_gvl, &args);
+  RB_GC_GUARD(rb_x);
+  RB_GC_GUARD(rb_scale);
+  RB_GC_GUARD(rb_bias);
+  return rb_out;
+}
+
+void Init_dnn_inference(VALUE rb_native) {
+  rb_define_module_function(rb_native, "dense_forward", rb_dense_forward, 7);
+  rb_define_module_function(rb_native, "conv2d_forward", rb_conv2d_forward, 12);
+  rb_define_module_function(rb_native, "affine_forward", rb_affine_forward, 5);
+}
+
+#else
+
+// The inference kernels write into Numo::SFloat buffers, so they are built only when the Numo headers are found.
+void Init_dnn_inference(VALUE rb_native) {
+}
+
+#endif
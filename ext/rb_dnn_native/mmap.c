@@ -0,0 +1,223 @@
+#include "rb_dnn_native.h"
+#include <string.h>
+
+// DNN::Native::MappedFile maps a file read-only and gathers fixed size rows from it.
+// It is not available on Windows; PackedTensor falls back to reading the file there.
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// num_gathers is the number of gathers copying from the mapping without the GVL.
+// close defers the unmap while they run, and the last one unmaps it. Both are changed only with the GVL held.
+typedef struct {
+  uint8_t* addr;
+  size_t size;
+  long num_gathers;
+  int closed;
+} mapped_file_t;
+
+typedef struct {
+  mapped_file_t* mf;
+  const uint8_t* src;
+  uint8_t* dest;
+  long* indexes;
+  long num_rows;
+  size_t row_bytes;
+  volatile VALUE indexes_v;
+} gather_args_t;
+
+static void mapped_file_unmap(mapped_file_t* mf) {
+  if (mf->addr) munmap(mf->addr, mf->size);
+  mf->addr = NULL;
+  mf->size = 0;
+}
+
+static void mapped_file_free(void* ptr) {
+  mapped_file_unmap((mapped_file_t*)ptr);
+  xfree(ptr);
+}
+
+static size_t mapped_file_memsize(const void* ptr) {
+  return sizeof(mapped_file_t);
+}
+
+static const rb_data_type_t mapped_file_type = {
+  "DNN::Native::MappedFile",
+  { NULL, mapped_file_free, mapped_file_memsize },
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+};
+
+static VALUE mapped_file_alloc(VALUE klass) {
+  mapped_file_t* mf;
+  VALUE obj = TypedData_Make_Struct(klass, mapped_file_t, &mapped_file_type, mf);
+  mf->addr = NULL;
+  mf->size = 0;
+  mf->num_gathers = 0;
+  mf->closed = 0;
+  return obj;
+}
+
+static mapped_file_t* mapped_file_get(VALUE self) {
+  mapped_file_t* mf;
+  TypedData_Get_Struct(self, mapped_file_t, &mapped_file_type, mf);
+  if (!mf->addr || mf->closed) rb_raise(rb_eIOError, "mapped file is closed.");
+  return mf;
+}
+
+// @param [String] file_name File name to map.
+// @param [Boolean] random Set true if rows are read in random order; it disables read-ahead.
+static VALUE mapped_file_initialize(VALUE self, VALUE rb_file_name, VALUE rb_random) {
+  mapped_file_t* mf;
+  struct stat st;
+  void* addr;
+  int fd;
+
+  TypedData_Get_Struct(self, mapped_file_t, &mapped_file_type, mf);
+  // Mapping again would leak the old mapping, or unmap it under the gathers running without the GVL.
+  if (mf->addr || mf->closed) rb_raise(rb_eIOError, "mapped file is already initialized.");
+  fd = open(StringValueCStr(rb_file_name), O_RDONLY);
+  if (fd < 0) rb_sys_fail(StringValueCStr(rb_file_name));
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    rb_sys_fail(StringValueCStr(rb_file_name));
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    rb_raise(rb_eIOError, "%s is empty.", StringValueCStr(rb_file_name));
+  }
+  addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) rb_sys_fail(StringValueCStr(rb_file_name));
+  madvise(addr, (size_t)st.st_size, RTEST(rb_random) ? MADV_RANDOM : MADV_SEQUENTIAL);
+  mf->addr = (uint8_t*)addr;
+  mf->size = (size_t)st.st_size;
+  return self;
+}
+
+static VALUE mapped_file_size(VALUE self) {
+  return SIZET2NUM(mapped_file_get(self)->size);
+}
+
+static VALUE mapped_file_read(VALUE self, VALUE rb_offset, VALUE rb_length) {
+  mapped_file_t* mf = mapped_file_get(self);
+  size_t offset = NUM2SIZET(rb_offset);
+  size_t length = NUM2SIZET(rb_length);
+
+  if (offset > mf->size || length > mf->size - offset) rb_raise(rb_eRangeError, "read out of range.");
+  return rb_str_new((const char*)mf->addr + offset, (long)length);
+}
+
+static void gather_rows(void* ptr, long begin, long end) {
+  gather_args_t* args = (gather_args_t*)ptr;
+  long i;
+
+  for (i = begin; i < end; i++) {
+    memcpy(args->dest + i * args->row_bytes, args->src + args->indexes[i] * args->row_bytes, args->row_bytes);
+  }
+}
+
+static void* gather_without_gvl(void* ptr) {
+  gather_args_t* args = (gather_args_t*)ptr;
+  // Page faults make each row cost far more than the copy, so even small batches are split.
+  dnn_parallel_for(args->num_rows, 8, gather_rows, args);
+  return NULL;
+}
+
+static VALUE gather_call(VALUE ptr) {
+  dnn_call_without_gvl(gather_without_gvl, (void*)ptr);
+  return Qnil;
+}
+
+// Run even if an interrupt raises after the GVL is acquired again, so that close is not blocked forever.
+static VALUE gather_ensure(VALUE ptr) {
+  gather_args_t* args = (gather_args_t*)ptr;
+  mapped_file_t* mf = args->mf;
+
+  rb_free_tmp_buffer(&args->indexes_v);
+  mf->num_gathers--;
+  if (mf->closed && mf->num_gathers == 0) mapped_file_unmap(mf);
+  return Qnil;
+}
+
+// Copy rows [offset + index * row_bytes, row_bytes) of indexes into buffer, in order.
+// buffer is either a String, which is resized to indexes.length * row_bytes, or a contiguous Numo::NArray
+// of exactly that byte size, which is written in place. Pass the same buffer every batch to reuse it.
+static VALUE mapped_file_gather(VALUE self, VALUE rb_offset, VALUE rb_row_bytes, VALUE rb_indexes, VALUE rb_buffer) {
+  mapped_file_t* mf = mapped_file_get(self);
+  size_t offset = NUM2SIZET(rb_offset);
+  size_t row_bytes = NUM2SIZET(rb_row_bytes);
+  long num_rows, max_rows, i;
+  uint8_t* dest;
+  gather_args_t args;
+
+  Check_Type(rb_indexes, T_ARRAY);
+  if (row_bytes == 0 || offset > mf->size) rb_raise(rb_eArgError, "invalid offset or row_bytes.");
+  max_rows = (long)((mf->size - offset) / row_bytes);
+  num_rows = RARRAY_LEN(rb_indexes);
+  if (RB_TYPE_P(rb_buffer, T_STRING)) {
+    rb_str_modify(rb_buffer);
+    rb_str_resize(rb_buffer, (long)(num_rows * row_bytes));
+    dest = (uint8_t*)RSTRING_PTR(rb_buffer);
+  } else {
+#ifdef HAVE_NUMO_NARRAY_H
+    size_t byte_size;
+    dest = (uint8_t*)dnn_narray_ptr(rb_buffer, &byte_size);
+    if (byte_size != num_rows * row_bytes) rb_raise(rb_eArgError, "The byte size of the buffer is mismatch.");
+#else
+    rb_raise(rb_eTypeError, "buffer must be a String.");
+#endif
+  }
+  // The indexes are a Ruby temporary buffer so that they are released even if an index check raises.
+  args.indexes = rb_alloc_tmp_buffer(&args.indexes_v, sizeof(long) * (num_rows > 0 ? num_rows : 1));
+  for (i = 0; i < num_rows; i++) {
+    long index = NUM2LONG(rb_ary_entry(rb_indexes, i));
+    if (index < 0 || index >= max_rows) {
+      rb_free_tmp_buffer(&args.indexes_v);
+      rb_raise(rb_eIndexError, "index %ld is out of range (0...%ld).", index, max_rows);
+    }
+    args.indexes[i] = index;
+  }
+
+  args.mf = mf;
+  args.src = mf->addr + offset;
+  args.dest = dest;
+  args.num_rows = num_rows;
+  args.row_bytes = row_bytes;
+  mf->num_gathers++;
+  rb_ensure(gather_call, (VALUE)&args, gather_ensure, (VALUE)&args);
+  return rb_buffer;
+}
+
+// The mapping is unmapped after the gathers running on other threads are finished.
+static VALUE mapped_file_close(VALUE self) {
+  mapped_file_t* mf;
+  TypedData_Get_Struct(self, mapped_file_t, &mapped_file_type, mf);
+  mf->closed = 1;
+  if (mf->num_gathers == 0) mapped_file_unmap(mf);
+  return Qnil;
+}
+
+void Init_dnn_mmap(VALUE rb_native) {
+  VALUE rb_mapped_file = rb_define_class_under(rb_native, "MappedFile", rb_cObject);
+
+  rb_define_alloc_func(rb_mapped_file, mapped_file_alloc);
+  rb_define_method(rb_mapped_file, "initialize", mapped_file_initialize, 2);
+  rb_define_method(rb_mapped_file, "size", mapped_file_size, 0);
+  rb_define_method(rb_mapped_file, "read", mapped_file_read, 2);
+  rb_define_method(rb_mapped_file, "gather", mapped_file_gather, 4);
+  rb_define_method(rb_mapped_file, "close", mapped_file_close, 0);
+#ifdef HAVE_NUMO_NARRAY_H
+  rb_define_const(rb_mapped_file, "GATHER_NARRAY", Qtrue);
+#else
+  rb_define_const(rb_mapped_file, "GATHER_NARRAY", Qfalse);
+#endif
+}
+#else
+void Init_dnn_mmap(VALUE rb_native) {
+}
+#endif
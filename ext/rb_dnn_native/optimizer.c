@@ -0,0 +1,373 @@
+#include "rb_dnn_native.h"
+
+#ifdef HAVE_NUMO_NARRAY_H
+#include <math.h>
+#include <numo/narray.h>
+
+// Every parameter is split into blocks of this many elements, and the blocks of all parameters
+// are processed in one parallel loop.
+#define OPTIMIZER_BLOCK_SIZE 16384
+
+enum {
+  OPT_SGD,
+  OPT_MOMENTUM,
+  OPT_NESTEROV,
+  OPT_ADAGRAD,
+  OPT_RMSPROP,
+  OPT_ADAM,
+  OPT_AMSGRAD
+};
+
+// One parameter. grad_step is 0 when the gradient is the scalar Xumo::SFloat[0] of an unused parameter.
+typedef struct {
+  float* data;
+  const float* grad;
+  float* state[3];
+  long size;
+  long grad_step;
+} opt_param_t;
+
+typedef struct {
+  long param_index;
+  long begin;
+  long end;
+} opt_block_t;
+
+typedef struct {
+  int kind;
+  opt_param_t* params;
+  opt_block_t* blocks;
+  long num_blocks;
+  float hp[4];
+  float clip_rate;
+  double* partial_sums;
+  // The tables are Ruby temporary buffers so that they are released even if an argument check raises.
+  volatile VALUE params_v;
+  volatile VALUE blocks_v;
+} opt_args_t;
+
+// Check that rb_narray is a contiguous Numo::SFloat and set its number of elements to size.
+static void narray_sfloat_check(VALUE rb_narray, long* size) {
+  if (!RTEST(rb_obj_is_kind_of(rb_narray, numo_cSFloat))) {
+    rb_raise(rb_eTypeError, "%"PRIsVALUE" is not an instance of Numo::SFloat.", rb_obj_class(rb_narray));
+  }
+  if (!na_check_contiguous(rb_narray)) {
+    rb_raise(rb_eArgError, "Numo::SFloat must be contiguous.");
+  }
+  *size = (long)RNARRAY_SIZE(rb_narray);
+}
+
+float* dnn_narray_sfloat_ptr(VALUE rb_narray, long* size) {
+  narray_sfloat_check(rb_narray, size);
+  // A contiguous view such as x[10...20, false] shares the data of the original narray,
+  // so the byte offset of the view is added to the pointer of the data.
+  return (float*)(na_get_pointer_for_write(rb_narray) + na_get_offset(rb_narray));
+}
+
+const float* dnn_narray_sfloat_ptr_for_read(VALUE rb_narray, long* size) {
+  char* ptr;
+
+  narray_sfloat_check(rb_narray, size);
+  ptr = na_get_pointer_for_read(rb_narray);
+  // The data of a narray that has never been written is not allocated yet.
+  if (!ptr) ptr = na_get_pointer_for_write(rb_narray);
+  return (const float*)(ptr + na_get_offset(rb_narray));
+}
+
+char* dnn_narray_ptr(VALUE rb_narray, size_t* byte_size) {
+  if (!RTEST(rb_obj_is_kind_of(rb_narray, numo_cNArray))) {
+    rb_raise(rb_eTypeError, "%"PRIsVALUE" is not an instance of Numo::NArray.", rb_obj_class(rb_narray));
+  }
+  if (!na_check_contiguous(rb_narray)) {
+    rb_raise(rb_eArgError, "Numo::NArray must be contiguous.");
+  }
+  *byte_size = (size_t)RNARRAY_SIZE(rb_narray) *
+               NUM2SIZET(rb_const_get(rb_obj_class(rb_narray), rb_intern("ELEMENT_BYTE_SIZE")));
+  return na_get_pointer_for_write(rb_narray) + na_get_offset(rb_narray);
+}
+
+// Build the parameter and block tables. rb_states is an Array of Arrays of state narrays.
+static void opt_args_init(opt_args_t* args, int kind, VALUE rb_datas, VALUE rb_grads, VALUE rb_states) {
+  long num_params, num_states, i, j;
+
+  Check_Type(rb_datas, T_ARRAY);
+  Check_Type(rb_grads, T_ARRAY);
+  Check_Type(rb_states, T_ARRAY);
+  num_params = RARRAY_LEN(rb_datas);
+  num_states = RARRAY_LEN(rb_states);
+  if (RARRAY_LEN(rb_grads) != num_params) rb_raise(rb_eArgError, "The number of grads is mismatch.");
+  if (num_states > 3) rb_raise(rb_eArgError, "Too many states.");
+  for (j = 0; j < num_states; j++) {
+    Check_Type(RARRAY_AREF(rb_states, j), T_ARRAY);
+    if (RARRAY_LEN(RARRAY_AREF(rb_states, j)) != num_params) rb_raise(rb_eArgError, "The number of states is mismatch.");
+  }
+
+  args->kind = kind;
+  args->blocks_v = 0;
+  args->params = rb_alloc_tmp_buffer(&args->params_v, sizeof(opt_param_t) * (num_params > 0 ? num_params : 1));
+  args->blocks = NULL;
+  args->num_blocks = 0;
+  args->partial_sums = NULL;
+  for (i = 0; i < num_params; i++) {
+    opt_param_t* param = &args->params[i];
+    long grad_size, state_size;
+
+    param->data = dnn_narray_sfloat_ptr(RARRAY_AREF(rb_datas, i), &param->size);
+    param->grad = dnn_narray_sfloat_ptr_for_read(RARRAY_AREF(rb_grads, i), &grad_size);
+    if (grad_size == param->size) {
+      param->grad_step = 1;
+    } else if (grad_size == 1) {
+      param->grad_step = 0;
+    } else {
+      rb_raise(rb_eArgError, "grad size is %ld, but expected size is %ld.", grad_size, param->size);
+    }
+    for (j = 0; j < num_states; j++) {
+      param->state[j] = dnn_narray_sfloat_ptr(RARRAY_AREF(RARRAY_AREF(rb_states, j), i), &state_size);
+      if (state_size != param->size) {
+        rb_raise(rb_eArgError, "state size is %ld, but expected size is %ld.", state_size, param->size);
+      }
+    }
+    args->num_blocks += (param->size + OPTIMIZER_BLOCK_SIZE - 1) / OPTIMIZER_BLOCK_SIZE;
+  }
+
+  args->blocks = rb_alloc_tmp_buffer(&args->blocks_v, sizeof(opt_block_t) * (args->num_blocks > 0 ? args->num_blocks : 1));
+  args->num_blocks = 0;
+  for (i = 0; i < num_params; i++) {
+    long begin;
+    for (begin = 0; begin < args->params[i].size; begin += OPTIMIZER_BLOCK_SIZE) {
+      opt_block_t* block = &args->blocks[args->num_blocks++];
+      block->param_index = i;
+      block->begin = begin;
+      block->end = begin + OPTIMIZER_BLOCK_SIZE < args->params[i].size ? begin + OPTIMIZER_BLOCK_SIZE : args->params[i].size;
+    }
+  }
+}
+
+static void opt_args_free(opt_args_t* args) {
+  rb_free_tmp_buffer(&args->params_v);
+  rb_free_tmp_buffer(&args->blocks_v);
+}
+
+// The update formulas are the same as update_variables of DNN::Optimizers.
+// The gradient is multiplied by clip_rate while it is read, so clipping needs no extra pass.
+// The kind is switched outside of the element loops so that each loop can be vectorized.
+static void update_block(opt_args_t* args, opt_block_t* block) {
+  opt_param_t* param = &args->params[block->param_index];
+  const float* hp = args->hp;
+  const float* grad = param->grad;
+  const long gs = param->grad_step;
+  const float rate = args->clip_rate;
+  float* data = param->data;
+  float* s0 = param->state[0];
+  float* s1 = param->state[1];
+  float* s2 = param->state[2];
+  long i;
+
+  switch (args->kind) {
+  case OPT_SGD:
+    // hp: lr
+    for (i = block->begin; i < block->end; i++) {
+      data[i] -= hp[0] * (grad[i * gs] * rate);
+    }
+    break;
+  case OPT_MOMENTUM:
+    // hp: lr, momentum
+    for (i = block->begin; i < block->end; i++) {
+      s0[i] = hp[0] * (grad[i * gs] * rate) + hp[1] * s0[i];
+      data[i] -= s0[i];
+    }
+    break;
+  case OPT_NESTEROV:
+    // hp: lr, momentum
+    for (i = block->begin; i < block->end; i++) {
+      const float amount = hp[0] * (grad[i * gs] * rate);
+      s0[i] = s0[i] * hp[1] - amount;
+      data[i] += hp[1] * hp[1] * s0[i] - (1 + hp[1]) * amount;
+    }
+    break;
+  case OPT_ADAGRAD:
+    // hp: lr, eps
+    for (i = block->begin; i < block->end; i++) {
+      const float g = grad[i * gs] * rate;
+      s0[i] += g * g;
+      data[i] -= hp[0] / sqrtf(s0[i] + hp[1]) * g;
+    }
+    break;
+  case OPT_RMSPROP:
+    // hp: lr, alpha, eps
+    for (i = block->begin; i < block->end; i++) {
+      const float g = grad[i * gs] * rate;
+      s0[i] = hp[1] * s0[i] + (1 - hp[1]) * g * g;
+      data[i] -= hp[0] / sqrtf(s0[i] + hp[2]) * g;
+    }
+    break;
+  case OPT_ADAM:
+    // hp: lr, beta1, beta2, eps
+    for (i = block->begin; i < block->end; i++) {
+      const float g = grad[i * gs] * rate;
+      s0[i] += (1 - hp[1]) * (g - s0[i]);
+      s1[i] += (1 - hp[2]) * (g * g - s1[i]);
+      data[i] -= hp[0] * s0[i] / sqrtf(s1[i] + hp[3]);
+    }
+    break;
+  case OPT_AMSGRAD:
+    // hp: lr, beta1, beta2, eps
+    for (i = block->begin; i < block->end; i++) {
+      const float g = grad[i * gs] * rate;
+      s0[i] += (1 - hp[1]) * (g - s0[i]);
+      s1[i] += (1 - hp[2]) * (g * g - s1[i]);
+      if (s2[i] < s1[i]) s2[i] = s1[i];
+      data[i] -= hp[0] * s0[i] / sqrtf(s2[i] + hp[3]);
+    }
+    break;
+  }
+}
+
+static void update_blocks(void* ptr, long begin, long end) {
+  opt_args_t* args = (opt_args_t*)ptr;
+  long b;
+
+  for (b = begin; b < end; b++) {
+    update_block(args, &args->blocks[b]);
+  }
+}
+
+static void* update_without_gvl(void* ptr) {
+  opt_args_t* args = (opt_args_t*)ptr;
+  dnn_parallel_for(args->num_blocks, 1, update_blocks, args);
+  return NULL;
+}
+
+static VALUE optimizer_update(int kind, VALUE rb_datas, VALUE rb_grads, VALUE rb_states,
+                              int num_hp, const VALUE* rb_hp, VALUE rb_clip_rate) {
+  opt_args_t args;
+  int i;
+
+  for (i = 0; i < num_hp; i++) {
+    args.hp[i] = (float)NUM2DBL(rb_hp[i]);
+  }
+  args.clip_rate = (float)NUM2DBL(rb_clip_rate);
+  opt_args_init(&args, kind, rb_datas, rb_grads, rb_states);
+  dnn_call_without_gvl(update_without_gvl, &args);
+  opt_args_free(&args);
+  RB_GC_GUARD(rb_datas);
+  RB_GC_GUARD(rb_grads);
+  RB_GC_GUARD(rb_states);
+  return Qnil;
+}
+
+// Each block writes the sum of its squared gradients to its own slot, so the total is deterministic.
+static void sum_squares_blocks(void* ptr, long begin, long end) {
+  opt_args_t* args = (opt_args_t*)ptr;
+  long b, i;
+
+  for (b = begin; b < end; b++) {
+    opt_block_t* block = &args->blocks[b];
+    opt_param_t* param = &args->params[block->param_index];
+    double sum = 0;
+
+    for (i = block->begin; i < block->end; i++) {
+      sum += (double)param->data[i] * param->data[i];
+    }
+    args->partial_sums[b] = sum;
+  }
+}
+
+static void* sum_squares_without_gvl(void* ptr) {
+  opt_args_t* args = (opt_args_t*)ptr;
+  dnn_parallel_for(args->num_blocks, 1, sum_squares_blocks, args);
+  return NULL;
+}
+
+/*
+  Native.sum_squares(narrays)
+  Return the sum of the squares of all elements of the narrays. It is used to compute the gradient norm.
+*/
+static VALUE rb_sum_squares(VALUE self, VALUE rb_narrays) {
+  opt_args_t args;
+  double total = 0;
+  volatile VALUE partial_sums_v = 0;
+  long b;
+
+  // The narrays are put in the data slot, and the grads are not read.
+  opt_args_init(&args, OPT_SGD, rb_narrays, rb_narrays, rb_ary_new());
+  args.partial_sums = rb_alloc_tmp_buffer(&partial_sums_v, sizeof(double) * (args.num_blocks > 0 ? args.num_blocks : 1));
+  dnn_call_without_gvl(sum_squares_without_gvl, &args);
+  for (b = 0; b < args.num_blocks; b++) {
+    total += args.partial_sums[b];
+  }
+  rb_free_tmp_buffer(&partial_sums_v);
+  opt_args_free(&args);
+  RB_GC_GUARD(rb_narrays);
+  return DBL2NUM(total);
+}
+
+/*
+  Native.sgd_update(datas, grads, vs, lr, momentum, clip_rate)
+  vs is nil when momentum is not used.
+*/
+static VALUE rb_sgd_update(VALUE self, VALUE rb_datas, VALUE rb_grads, VALUE rb_vs,
+                           VALUE rb_lr, VALUE rb_momentum, VALUE rb_clip_rate) {
+  VALUE hp[2] = { rb_lr, rb_momentum };
+  if (NIL_P(rb_vs)) {
+    return optimizer_update(OPT_SGD, rb_datas, rb_grads, rb_ary_new(), 1, hp, rb_clip_rate);
+  }
+  return optimizer_update(OPT_MOMENTUM, rb_datas, rb_grads, rb_ary_new_from_args(1, rb_vs), 2, hp, rb_clip_rate);
+}
+
+/*
+  Native.nesterov_update(datas, grads, vs, lr, momentum, clip_rate)
+*/
+static VALUE rb_nesterov_update(VALUE self, VALUE rb_datas, VALUE rb_grads, VALUE rb_vs,
+                                VALUE rb_lr, VALUE rb_momentum, VALUE rb_clip_rate) {
+  VALUE hp[2] = { rb_lr, rb_momentum };
+  return optimizer_update(OPT_NESTEROV, rb_datas, rb_grads, rb_ary_new_from_args(1, rb_vs), 2, hp, rb_clip_rate);
+}
+
+/*
+  Native.adagrad_update(datas, grads, gs, lr, eps, clip_rate)
+*/
+static VALUE rb_adagrad_update(VALUE self, VALUE rb_datas, VALUE rb_grads, VALUE rb_gs,
+                               VALUE rb_lr, VALUE rb_eps, VALUE rb_clip_rate) {
+  VALUE hp[2] = { rb_lr, rb_eps };
+  return optimizer_update(OPT_ADAGRAD, rb_datas, rb_grads, rb_ary_new_from_args(1, rb_gs), 2, hp, rb_clip_rate);
+}
+
+/*
+  Native.rmsprop_update(datas, grads, gs, lr, alpha, eps, clip_rate)
+*/
+static VALUE rb_rmsprop_update(VALUE self, VALUE rb_datas, VALUE rb_grads, VALUE rb_gs,
+                               VALUE rb_lr, VALUE rb_alpha, VALUE rb_eps, VALUE rb_clip_rate) {
+  VALUE hp[3] = { rb_lr, rb_alpha, rb_eps };
+  return optimizer_update(OPT_RMSPROP, rb_datas, rb_grads, rb_ary_new_from_args(1, rb_gs), 3, hp, rb_clip_rate);
+}
+
+/*
+  Native.adam_update(datas, grads, ms, vs, ss, lr, beta1, beta2, eps, clip_rate)
+  lr is the bias corrected learning rate. ss is nil when amsgrad is not used.
+*/
+static VALUE rb_adam_update(VALUE self, VALUE rb_datas, VALUE rb_grads, VALUE rb_ms, VALUE rb_vs, VALUE rb_ss,
+                            VALUE rb_lr, VALUE rb_beta1, VALUE rb_beta2, VALUE rb_eps, VALUE rb_clip_rate) {
+  VALUE hp[4] = { rb_lr, rb_beta1, rb_beta2, rb_eps };
+  if (NIL_P(rb_ss)) {
+    return optimizer_update(OPT_ADAM, rb_datas, rb_grads, rb_ary_new_from_args(2, rb_ms, rb_vs), 4, hp, rb_clip_rate);
+  }
+  return optimizer_update(OPT_AMSGRAD, rb_datas, rb_grads, rb_ary_new_from_args(3, rb_ms, rb_vs, rb_ss), 4, hp, rb_clip_rate);
+}
+
+void Init_dnn_optimizer(VALUE rb_native) {
+  rb_define_module_function(rb_native, "sum_squares", rb_sum_squares, 1);
+  rb_define_module_function(rb_native, "sgd_update", rb_sgd_update, 6);
+  rb_define_module_function(rb_native, "nesterov_update", rb_nesterov_update, 6);
+  rb_define_module_function(rb_native, "adagrad_update", rb_adagrad_update, 6);
+  rb_define_module_function(rb_native, "rmsprop_update", rb_rmsprop_update, 7);
+  rb_define_module_function(rb_native, "adam_update", rb_adam_update, 10);
+}
+
+#else
+
+// The optimizer kernels update Numo::SFloat in place, so they are built only when the Numo headers are found.
+void Init_dnn_optimizer(VALUE rb_native) {
+}
+
+#endif
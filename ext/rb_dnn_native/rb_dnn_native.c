@@ -0,0 +1,137 @@
+#include "rb_dnn_native.h"
+#include <ruby/thread.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#define RB_DNN_USE_PTHREAD
+#endif
+
+static int32_t num_threads = 1;
+
+typedef struct {
+  dnn_parallel_func_t func;
+  void* args;
+  long n;
+  long chunk;
+  long next_begin;
+#ifdef RB_DNN_USE_PTHREAD
+  pthread_mutex_t mutex;
+#endif
+} parallel_for_args_t;
+
+static long parallel_for_fetch(parallel_for_args_t* pargs) {
+  long begin;
+#ifdef RB_DNN_USE_PTHREAD
+  pthread_mutex_lock(&pargs->mutex);
+#endif
+  begin = pargs->next_begin;
+  pargs->next_begin += pargs->chunk;
+#ifdef RB_DNN_USE_PTHREAD
+  pthread_mutex_unlock(&pargs->mutex);
+#endif
+  return begin;
+}
+
+static void* parallel_for_worker(void* ptr) {
+  parallel_for_args_t* pargs = (parallel_for_args_t*)ptr;
+  long begin;
+
+  while ((begin = parallel_for_fetch(pargs)) < pargs->n) {
+    long end = begin + pargs->chunk;
+    pargs->func(pargs->args, begin, end < pargs->n ? end : pargs->n);
+  }
+  return NULL;
+}
+
+void dnn_parallel_for(long n, long min_chunk, dnn_parallel_func_t func, void* args) {
+#ifdef RB_DNN_USE_PTHREAD
+  parallel_for_args_t pargs;
+  pthread_t threads[256];
+  long max_threads = num_threads < 256 ? num_threads : 256;
+  long num_started = 0;
+  long i;
+
+  if (min_chunk < 1) min_chunk = 1;
+  if (max_threads > n / min_chunk) max_threads = n / min_chunk;
+  if (max_threads <= 1) {
+    func(args, 0, n);
+    return;
+  }
+  pargs.func = func;
+  pargs.args = args;
+  pargs.n = n;
+  // Several chunks per thread keep the load balanced when items take uneven time.
+  pargs.chunk = (n + max_threads * 4 - 1) / (max_threads * 4);
+  if (pargs.chunk < min_chunk) pargs.chunk = min_chunk;
+  pargs.next_begin = 0;
+  pthread_mutex_init(&pargs.mutex, NULL);
+  // The calling thread also works, so only max_threads - 1 helpers are spawned.
+  for (i = 1; i < max_threads; i++) {
+    if (pthread_create(&threads[num_started], NULL, parallel_for_worker, &pargs) != 0) break;
+    num_started++;
+  }
+  parallel_for_worker(&pargs);
+  for (i = 0; i < num_started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_mutex_destroy(&pargs.mutex);
+#else
+  func(args, 0, n);
+#endif
+}
+
+void dnn_call_without_gvl(void* (*func)(void*), void* args) {
+  rb_thread_call_without_gvl(func, args, NULL, NULL);
+}
+
+float* dnn_sfloat_ptr(VALUE rb_bin, long size) {
+  StringValue(rb_bin);
+  if (RSTRING_LEN(rb_bin) != (long)(size * sizeof(float))) {
+    rb_raise(rb_eArgError, "binary size is %ld, but expected binary size is %ld.",
+             RSTRING_LEN(rb_bin), (long)(size * sizeof(float)));
+  }
+  return (float*)RSTRING_PTR(rb_bin);
+}
+
+int32_t dnn_ary_int(VALUE rb_ary, long index) {
+  Check_Type(rb_ary, T_ARRAY);
+  return NUM2INT(rb_ary_entry(rb_ary, index));
+}
+
+static VALUE rb_num_threads(VALUE self) {
+  return INT2FIX(num_threads);
+}
+
+static VALUE rb_set_num_threads(VALUE self, VALUE rb_num_threads) {
+  int32_t n = NUM2INT(rb_num_threads);
+  if (n < 1) rb_raise(rb_eArgError, "num_threads must be 1 or more.");
+  num_threads = n;
+  return rb_num_threads;
+}
+
+static int32_t default_num_threads(void) {
+#ifdef RB_DNN_USE_PTHREAD
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int32_t)n : 1;
+#else
+  return 1;
+#endif
+}
+
+void Init_rb_dnn_native(void) {
+  VALUE rb_dnn = rb_define_module("DNN");
+  VALUE rb_native = rb_define_module_under(rb_dnn, "Native");
+
+  num_threads = default_num_threads();
+  rb_define_module_function(rb_native, "num_threads", rb_num_threads, 0);
+  rb_define_module_function(rb_native, "num_threads=", rb_set_num_threads, 1);
+
+  Init_dnn_im2col(rb_native);
+  Init_dnn_rnn(rb_native);
+  Init_dnn_mmap(rb_native);
+  Init_dnn_optimizer(rb_native);
+  Init_dnn_inference(rb_native);
+}
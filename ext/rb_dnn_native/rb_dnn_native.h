@@ -0,0 +1,49 @@
+#ifndef RB_DNN_NATIVE_H
+#define RB_DNN_NATIVE_H
+
+#include <ruby.h>
+#include <stdint.h>
+
+// Process [0, n) in chunks of at least min_chunk items on the native thread pool.
+// It must be called without holding the GVL.
+typedef void (*dnn_parallel_func_t)(void* args, long begin, long end);
+void dnn_parallel_for(long n, long min_chunk, dnn_parallel_func_t func, void* args);
+
+// Run func without holding the GVL.
+void dnn_call_without_gvl(void* (*func)(void*), void* args);
+
+// Check that a binary string holds exactly size floats and return its pointer.
+float* dnn_sfloat_ptr(VALUE rb_bin, long size);
+
+int32_t dnn_ary_int(VALUE rb_ary, long index);
+
+// Row-major C = op(A) * op(B) + beta * C, where op(A) is [m, k] and op(B) is [k, n].
+// It must be called without holding the GVL.
+void dnn_sgemm(int trans_a, int trans_b, long m, long n, long k,
+               const float* a, long lda, const float* b, long ldb, float beta, float* c, long ldc);
+
+// NHWC img[bsize, img_h, img_w, ch] to col[bsize * out_h * out_w, fil_h * fil_w * ch].
+// pad is the total padding of each axis. It must be called without holding the GVL.
+void dnn_im2col(const float* img, float* col, const int32_t img_shape[4], const int32_t out_size[2],
+                const int32_t filter_size[2], const int32_t strides[2], const int32_t pad[2]);
+
+#ifdef HAVE_NUMO_NARRAY_H
+// Check that rb_narray is a contiguous Numo::SFloat, set its number of elements to size and
+// return the writable pointer to its first element. The offset of a view is included.
+float* dnn_narray_sfloat_ptr(VALUE rb_narray, long* size);
+
+// Same as dnn_narray_sfloat_ptr, but the pointer is only read, so a frozen narray is accepted.
+const float* dnn_narray_sfloat_ptr_for_read(VALUE rb_narray, long* size);
+
+// Check that rb_narray is a contiguous Numo::NArray of any dtype, set its byte size to byte_size and
+// return the writable pointer to its first element. The offset of a view is included.
+char* dnn_narray_ptr(VALUE rb_narray, size_t* byte_size);
+#endif
+
+void Init_dnn_im2col(VALUE rb_native);
+void Init_dnn_rnn(VALUE rb_native);
+void Init_dnn_mmap(VALUE rb_native);
+void Init_dnn_optimizer(VALUE rb_native);
+void Init_dnn_inference(VALUE rb_native);
+
+#endif
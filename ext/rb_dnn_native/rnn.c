@@ -0,0 +1,414 @@
+#include "rb_dnn_native.h"
+#include <math.h>
+#include <string.h>
+
+// Whole-sequence LSTM and GRU kernels. Sequences are [bsize, time, features] and the
+// per-step caches are kept in the same layout, so step t of every batch row is found at
+// offset t * features with a row stride of time * features.
+typedef struct {
+  long bsize, time, in_dim, units;
+  int return_sequences;
+  int requires_dx;
+  const float* xs;
+  const float* h0;
+  const float* c0;
+  const float* weight;
+  const float* recurrent_weight;
+  const float* bias;
+  const float* dys;
+  float* hs;
+  float* cs;
+  float* gates;
+  float* hr;
+  float* dxs;
+  float* dh0;
+  float* dc0;
+  float* dweight;
+  float* drecurrent_weight;
+  float* dbias;
+  // Scratch buffers of the backward. They are allocated by rnn_alloc_scratch with the GVL held.
+  float* da;
+  float* dh_next;
+  float* dc_next;
+  float* dh2;
+  float* dhr;
+  float* h_prevs;
+  volatile VALUE scratch_v;
+} rnn_args_t;
+
+static inline float sigmoidf(float x) {
+  return 1.0f / (1.0f + expf(-x));
+}
+
+static void rnn_args_init(rnn_args_t* args, VALUE rb_dims) {
+  memset(args, 0, sizeof(rnn_args_t));
+  args->bsize = dnn_ary_int(rb_dims, 0);
+  args->time = dnn_ary_int(rb_dims, 1);
+  args->in_dim = dnn_ary_int(rb_dims, 2);
+  args->units = dnn_ary_int(rb_dims, 3);
+  if (args->bsize < 1 || args->time < 1 || args->in_dim < 1 || args->units < 1) {
+    rb_raise(rb_eArgError, "RNN dims must be positive.");
+  }
+}
+
+static VALUE rnn_new_sfloat(long size, float** ptr) {
+  VALUE rb_bin = rb_str_new(NULL, size * sizeof(float));
+  *ptr = (float*)RSTRING_PTR(rb_bin);
+  return rb_bin;
+}
+
+// gates[bsize * time, num_gates] = xs.dot(weight) + bias
+static void rnn_input_projection(rnn_args_t* args, long num_gates) {
+  const long rows = args->bsize * args->time;
+  long r;
+
+  if (args->bias) {
+    for (r = 0; r < rows; r++) memcpy(args->gates + r * num_gates, args->bias, sizeof(float) * num_gates);
+  }
+  dnn_sgemm(0, 0, rows, num_gates, args->in_dim, args->xs, args->in_dim, args->weight, num_gates,
+            args->bias ? 1.0f : 0.0f, args->gates, num_gates);
+}
+
+// The gradient reaching step t from the layer output.
+static inline float rnn_dy(rnn_args_t* args, long b, long t, long j) {
+  if (args->return_sequences) return args->dys[(b * args->time + t) * args->units + j];
+  return t == args->time - 1 ? args->dys[b * args->units + j] : 0.0f;
+}
+
+// Allocate the scratch buffers of the backward in one Ruby temporary buffer, so that an allocation failure raises
+// NoMemoryError and the buffer is released even if an exception is raised. dh_next and dc_next are zero filled.
+static void rnn_alloc_scratch(rnn_args_t* args, long num_gates, int gru) {
+  const long B = args->bsize, T = args->time, H = args->units;
+  const long size = B * T * num_gates + B * H * 3 + B * T * H;
+  float* scratch = (float*)rb_alloc_tmp_buffer(&args->scratch_v, (long)(sizeof(float) * size));
+
+  args->da = scratch;
+  args->dh_next = args->da + B * T * num_gates;
+  if (gru) {
+    args->dh2 = args->dh_next + B * H;
+    args->dhr = args->dh2 + B * H;
+    args->h_prevs = args->dhr + B * H;
+  } else {
+    args->dc_next = args->dh_next + B * H;
+    args->h_prevs = args->dc_next + B * H;
+  }
+  memset(args->dh_next, 0, sizeof(float) * B * H * 2);
+}
+
+static void rnn_free_scratch(rnn_args_t* args) {
+  rb_free_tmp_buffer(&args->scratch_v);
+}
+
+// h of the previous step for every step, i.e. [h0, hs[:, 0...-1]].
+static void rnn_prev_states(rnn_args_t* args, float* prev, const float* states, const float* init) {
+  const long H = args->units;
+  long b;
+
+  for (b = 0; b < args->bsize; b++) {
+    float* dest = prev + b * args->time * H;
+    memcpy(dest, init + b * H, sizeof(float) * H);
+    memcpy(dest + H, states + b * args->time * H, sizeof(float) * (args->time - 1) * H);
+  }
+}
+
+// Gradients of the parameters and inputs that are shared by every step, computed with one GEMM each.
+static void rnn_backward_inputs(rnn_args_t* args, const float* da, long num_gates) {
+  const long rows = args->bsize * args->time;
+  long r, j;
+
+  dnn_sgemm(1, 0, args->in_dim, num_gates, rows, args->xs, args->in_dim, da, num_gates, 0.0f, args->dweight, num_gates);
+  memset(args->dbias, 0, sizeof(float) * num_gates);
+  for (r = 0; r < rows; r++) {
+    const float* da_row = da + r * num_gates;
+    for (j = 0; j < num_gates; j++) args->dbias[j] += da_row[j];
+  }
+  if (args->requires_dx) {
+    dnn_sgemm(0, 1, rows, args->in_dim, num_gates, da, num_gates, args->weight, num_gates, 0.0f, args->dxs, args->in_dim);
+  }
+}
+
+// LSTM gates are laid out as [forget, g, in, out].
+static void* lstm_forward_without_gvl(void* ptr) {
+  rnn_args_t* args = (rnn_args_t*)ptr;
+  const long B = args->bsize, T = args->time, H = args->units, G = H * 4;
+  long t, b, j;
+
+  rnn_input_projection(args, G);
+  for (t = 0; t < T; t++) {
+    const float* h_prev = t ? args->hs + (t - 1) * H : args->h0;
+    const float* c_prev = t ? args->cs + (t - 1) * H : args->c0;
+    const long ld_prev = t ? T * H : H;
+
+    dnn_sgemm(0, 0, B, G, H, h_prev, ld_prev, args->recurrent_weight, G, 1.0f, args->gates + t * G, T * G);
+    for (b = 0; b < B; b++) {
+      float* a = args->gates + (b * T + t) * G;
+      float* c = args->cs + (b * T + t) * H;
+      float* h = args->hs + (b * T + t) * H;
+      for (j = 0; j < H; j++) {
+        const float f = sigmoidf(a[j]);
+        const float g = tanhf(a[H + j]);
+        const float i = sigmoidf(a[H * 2 + j]);
+        const float o = sigmoidf(a[H * 3 + j]);
+        a[j] = f;
+        a[H + j] = g;
+        a[H * 2 + j] = i;
+        a[H * 3 + j] = o;
+        c[j] = f * c_prev[b * ld_prev + j] + g * i;
+        h[j] = o * tanhf(c[j]);
+      }
+    }
+  }
+  return NULL;
+}
+
+static void* lstm_backward_without_gvl(void* ptr) {
+  rnn_args_t* args = (rnn_args_t*)ptr;
+  const long B = args->bsize, T = args->time, H = args->units, G = H * 4;
+  float* da = args->da;
+  float* dh_next = args->dh_next;
+  float* dc_next = args->dc_next;
+  long t, b, j;
+
+  for (t = T - 1; t >= 0; t--) {
+    const float* c_prev = t ? args->cs + (t - 1) * H : args->c0;
+    const long ld_prev = t ? T * H : H;
+
+    for (b = 0; b < B; b++) {
+      const float* a = args->gates + (b * T + t) * G;
+      const float* c = args->cs + (b * T + t) * H;
+      float* da_row = da + (b * T + t) * G;
+      for (j = 0; j < H; j++) {
+        const float f = a[j], g = a[H + j], i = a[H * 2 + j], o = a[H * 3 + j];
+        const float tanh_c = tanhf(c[j]);
+        const float dh = dh_next[b * H + j] + rnn_dy(args, b, t, j);
+        const float dc = dc_next[b * H + j] + dh * o * (1.0f - tanh_c * tanh_c);
+        da_row[j] = dc * c_prev[b * ld_prev + j] * f * (1.0f - f);
+        da_row[H + j] = dc * i * (1.0f - g * g);
+        da_row[H * 2 + j] = dc * g * i * (1.0f - i);
+        da_row[H * 3 + j] = dh * tanh_c * o * (1.0f - o);
+        dc_next[b * H + j] = dc * f;
+      }
+    }
+    dnn_sgemm(0, 1, B, H, G, da + t * G, T * G, args->recurrent_weight, G, 0.0f, dh_next, H);
+  }
+  memcpy(args->dh0, dh_next, sizeof(float) * B * H);
+  memcpy(args->dc0, dc_next, sizeof(float) * B * H);
+
+  rnn_prev_states(args, args->h_prevs, args->hs, args->h0);
+  dnn_sgemm(1, 0, H, G, B * T, args->h_prevs, H, da, G, 0.0f, args->drecurrent_weight, G);
+  rnn_backward_inputs(args, da, G);
+  return NULL;
+}
+
+// GRU gates are laid out as [update, reset, h]. hr caches h_prev * reset for every step.
+static void* gru_forward_without_gvl(void* ptr) {
+  rnn_args_t* args = (rnn_args_t*)ptr;
+  const long B = args->bsize, T = args->time, H = args->units, G = H * 3;
+  long t, b, j;
+
+  rnn_input_projection(args, G);
+  for (t = 0; t < T; t++) {
+    const float* h_prev = t ? args->hs + (t - 1) * H : args->h0;
+    const long ld_prev = t ? T * H : H;
+
+    dnn_sgemm(0, 0, B, H * 2, H, h_prev, ld_prev, args->recurrent_weight, G, 1.0f, args->gates + t * G, T * G);
+    for (b = 0; b < B; b++) {
+      float* a = args->gates + (b * T + t) * G;
+      float* hr = args->hr + (b * T + t) * H;
+      for (j = 0; j < H * 2; j++) a[j] = sigmoidf(a[j]);
+      for (j = 0; j < H; j++) hr[j] = h_prev[b * ld_prev + j] * a[H + j];
+    }
+    dnn_sgemm(0, 0, B, H, H, args->hr + t * H, T * H, args->recurrent_weight + H * 2, G, 1.0f,
+              args->gates + t * G + H * 2, T * G);
+    for (b = 0; b < B; b++) {
+      float* a = args->gates + (b * T + t) * G;
+      float* h = args->hs + (b * T + t) * H;
+      for (j = 0; j < H; j++) {
+        const float u = a[j];
+        const float hh = tanhf(a[H * 2 + j]);
+        a[H * 2 + j] = hh;
+        h[j] = (1.0f - u) * hh + u * h_prev[b * ld_prev + j];
+      }
+    }
+  }
+  return NULL;
+}
+
+static void* gru_backward_without_gvl(void* ptr) {
+  rnn_args_t* args = (rnn_args_t*)ptr;
+  const long B = args->bsize, T = args->time, H = args->units, G = H * 3;
+  float* da = args->da;
+  float* dh_next = args->dh_next;
+  float* dh2 = args->dh2;
+  float* dhr = args->dhr;
+  long t, b, j;
+
+  for (t = T - 1; t >= 0; t--) {
+    const float* h_prev = t ? args->hs + (t - 1) * H : args->h0;
+    const long ld_prev = t ? T * H : H;
+
+    for (b = 0; b < B; b++) {
+      const float* a = args->gates + (b * T + t) * G;
+      float* da_row = da + (b * T + t) * G;
+      for (j = 0; j < H; j++) {
+        const float u = a[j], hh = a[H * 2 + j];
+        const float dh = dh_next[b * H + j] + rnn_dy(args, b, t, j);
+        dh2[b * H + j] = dh;
+        da_row[H * 2 + j] = dh * (1.0f - u) * (1.0f - hh * hh);
+      }
+    }
+    // dhr = da_h.dot(recurrent_weight_h.transpose)
+    dnn_sgemm(0, 1, B, H, H, da + t * G + H * 2, T * G, args->recurrent_weight + H * 2, G, 0.0f, dhr, H);
+    for (b = 0; b < B; b++) {
+      const float* a = args->gates + (b * T + t) * G;
+      float* da_row = da + (b * T + t) * G;
+      for (j = 0; j < H; j++) {
+        const float u = a[j], r = a[H + j], hh = a[H * 2 + j];
+        const float h = h_prev[b * ld_prev + j];
+        const float dh = dh2[b * H + j];
+        da_row[j] = dh * (h - hh) * u * (1.0f - u);
+        da_row[H + j] = dhr[b * H + j] * h * r * (1.0f - r);
+        dh_next[b * H + j] = dh * u + dhr[b * H + j] * r;
+      }
+    }
+    dnn_sgemm(0, 1, B, H, H * 2, da + t * G, T * G, args->recurrent_weight, G, 1.0f, dh_next, H);
+  }
+  memcpy(args->dh0, dh_next, sizeof(float) * B * H);
+
+  rnn_prev_states(args, args->h_prevs, args->hs, args->h0);
+  dnn_sgemm(1, 0, H, H * 2, B * T, args->h_prevs, H, da, G, 0.0f, args->drecurrent_weight, G);
+  dnn_sgemm(1, 0, H, H, B * T, args->hr, H, da + H * 2, G, 0.0f, args->drecurrent_weight + H * 2, G);
+  rnn_backward_inputs(args, da, G);
+  return NULL;
+}
+
+static void rnn_set_params(rnn_args_t* args, VALUE rb_xs, VALUE rb_h0, VALUE rb_weight, VALUE rb_recurrent_weight,
+                           long num_gates) {
+  const long B = args->bsize, T = args->time, D = args->in_dim, H = args->units;
+  args->xs = dnn_sfloat_ptr(rb_xs, B * T * D);
+  args->h0 = dnn_sfloat_ptr(rb_h0, B * H);
+  args->weight = dnn_sfloat_ptr(rb_weight, D * num_gates);
+  args->recurrent_weight = dnn_sfloat_ptr(rb_recurrent_weight, H * num_gates);
+}
+
+static VALUE rb_lstm_forward(VALUE self, VALUE rb_xs, VALUE rb_h0, VALUE rb_c0, VALUE rb_weight, VALUE rb_recurrent_weight,
+                             VALUE rb_bias, VALUE rb_dims) {
+  rnn_args_t args;
+  VALUE rb_hs, rb_cs, rb_gates;
+
+  rnn_args_init(&args, rb_dims);
+  rnn_set_params(&args, rb_xs, rb_h0, rb_weight, rb_recurrent_weight, args.units * 4);
+  args.c0 = dnn_sfloat_ptr(rb_c0, args.bsize * args.units);
+  if (!NIL_P(rb_bias)) args.bias = dnn_sfloat_ptr(rb_bias, args.units * 4);
+  rb_hs = rnn_new_sfloat(args.bsize * args.time * args.units, &args.hs);
+  rb_cs = rnn_new_sfloat(args.bsize * args.time * args.units, &args.cs);
+  rb_gates = rnn_new_sfloat(args.bsize * args.time * args.units * 4, &args.gates);
+  dnn_call_without_gvl(lstm_forward_without_gvl, &args);
+  RB_GC_GUARD(rb_xs);
+  RB_GC_GUARD(rb_h0);
+  RB_GC_GUARD(rb_c0);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_recurrent_weight);
+  RB_GC_GUARD(rb_bias);
+  return rb_ary_new3(3, rb_hs, rb_cs, rb_gates);
+}
+
+static VALUE rb_lstm_backward(VALUE self, VALUE rb_xs, VALUE rb_h0, VALUE rb_c0, VALUE rb_weight, VALUE rb_recurrent_weight,
+                              VALUE rb_hs, VALUE rb_cs, VALUE rb_gates, VALUE rb_dys, VALUE rb_dims,
+                              VALUE rb_return_sequences, VALUE rb_requires_dx) {
+  rnn_args_t args;
+  long B, T, D, H;
+  VALUE rb_dxs = Qnil, rb_dh0, rb_dc0, rb_dweight, rb_drecurrent_weight, rb_dbias;
+
+  rnn_args_init(&args, rb_dims);
+  B = args.bsize, T = args.time, D = args.in_dim, H = args.units;
+  rnn_set_params(&args, rb_xs, rb_h0, rb_weight, rb_recurrent_weight, H * 4);
+  args.c0 = dnn_sfloat_ptr(rb_c0, B * H);
+  args.hs = dnn_sfloat_ptr(rb_hs, B * T * H);
+  args.cs = dnn_sfloat_ptr(rb_cs, B * T * H);
+  args.gates = dnn_sfloat_ptr(rb_gates, B * T * H * 4);
+  args.return_sequences = RTEST(rb_return_sequences);
+  args.requires_dx = RTEST(rb_requires_dx);
+  args.dys = dnn_sfloat_ptr(rb_dys, args.return_sequences ? B * T * H : B * H);
+  if (args.requires_dx) rb_dxs = rnn_new_sfloat(B * T * D, &args.dxs);
+  rb_dh0 = rnn_new_sfloat(B * H, &args.dh0);
+  rb_dc0 = rnn_new_sfloat(B * H, &args.dc0);
+  rb_dweight = rnn_new_sfloat(D * H * 4, &args.dweight);
+  rb_drecurrent_weight = rnn_new_sfloat(H * H * 4, &args.drecurrent_weight);
+  rb_dbias = rnn_new_sfloat(H * 4, &args.dbias);
+  rnn_alloc_scratch(&args, H * 4, 0);
+  dnn_call_without_gvl(lstm_backward_without_gvl, &args);
+  rnn_free_scratch(&args);
+  RB_GC_GUARD(rb_xs);
+  RB_GC_GUARD(rb_h0);
+  RB_GC_GUARD(rb_c0);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_recurrent_weight);
+  RB_GC_GUARD(rb_hs);
+  RB_GC_GUARD(rb_cs);
+  RB_GC_GUARD(rb_gates);
+  RB_GC_GUARD(rb_dys);
+  return rb_ary_new3(6, rb_dxs, rb_dh0, rb_dc0, rb_dweight, rb_drecurrent_weight, rb_dbias);
+}
+
+static VALUE rb_gru_forward(VALUE self, VALUE rb_xs, VALUE rb_h0, VALUE rb_weight, VALUE rb_recurrent_weight,
+                            VALUE rb_bias, VALUE rb_dims) {
+  rnn_args_t args;
+  VALUE rb_hs, rb_gates, rb_hr;
+
+  rnn_args_init(&args, rb_dims);
+  rnn_set_params(&args, rb_xs, rb_h0, rb_weight, rb_recurrent_weight, args.units * 3);
+  if (!NIL_P(rb_bias)) args.bias = dnn_sfloat_ptr(rb_bias, args.units * 3);
+  rb_hs = rnn_new_sfloat(args.bsize * args.time * args.units, &args.hs);
+  rb_gates = rnn_new_sfloat(args.bsize * args.time * args.units * 3, &args.gates);
+  rb_hr = rnn_new_sfloat(args.bsize * args.time * args.units, &args.hr);
+  dnn_call_without_gvl(gru_forward_without_gvl, &args);
+  RB_GC_GUARD(rb_xs);
+  RB_GC_GUARD(rb_h0);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_recurrent_weight);
+  RB_GC_GUARD(rb_bias);
+  return rb_ary_new3(3, rb_hs, rb_gates, rb_hr);
+}
+
+static VALUE rb_gru_backward(VALUE self, VALUE rb_xs, VALUE rb_h0, VALUE rb_weight, VALUE rb_recurrent_weight,
+                             VALUE rb_hs, VALUE rb_gates, VALUE rb_hr, VALUE rb_dys, VALUE rb_dims,
+                             VALUE rb_return_sequences, VALUE rb_requires_dx) {
+  rnn_args_t args;
+  long B, T, D, H;
+  VALUE rb_dxs = Qnil, rb_dh0, rb_dweight, rb_drecurrent_weight, rb_dbias;
+
+  rnn_args_init(&args, rb_dims);
+  B = args.bsize, T = args.time, D = args.in_dim, H = args.units;
+  rnn_set_params(&args, rb_xs, rb_h0, rb_weight, rb_recurrent_weight, H * 3);
+  args.hs = dnn_sfloat_ptr(rb_hs, B * T * H);
+  args.gates = dnn_sfloat_ptr(rb_gates, B * T * H * 3);
+  args.hr = dnn_sfloat_ptr(rb_hr, B * T * H);
+  args.return_sequences = RTEST(rb_return_sequences);
+  args.requires_dx = RTEST(rb_requires_dx);
+  args.dys = dnn_sfloat_ptr(rb_dys, args.return_sequences ? B * T * H : B * H);
+  if (args.requires_dx) rb_dxs = rnn_new_sfloat(B * T * D, &args.dxs);
+  rb_dh0 = rnn_new_sfloat(B * H, &args.dh0);
+  rb_dweight = rnn_new_sfloat(D * H * 3, &args.dweight);
+  rb_drecurrent_weight = rnn_new_sfloat(H * H * 3, &args.drecurrent_weight);
+  rb_dbias = rnn_new_sfloat(H * 3, &args.dbias);
+  rnn_alloc_scratch(&args, H * 3, 1);
+  dnn_call_without_gvl(gru_backward_without_gvl, &args);
+  rnn_free_scratch(&args);
+  RB_GC_GUARD(rb_xs);
+  RB_GC_GUARD(rb_h0);
+  RB_GC_GUARD(rb_weight);
+  RB_GC_GUARD(rb_recurrent_weight);
+  RB_GC_GUARD(rb_hs);
+  RB_GC_GUARD(rb_gates);
+  RB_GC_GUARD(rb_hr);
+  RB_GC_GUARD(rb_dys);
+  return rb_ary_new3(5, rb_dxs, rb_dh0, rb_dweight, rb_drecurrent_weight, rb_dbias);
+}
+
+void Init_dnn_rnn(VALUE rb_native) {
+  rb_define_module_function(rb_native, "lstm_forward", rb_lstm_forward, 7);
+  rb_define_module_function(rb_native, "lstm_backward", rb_lstm_backward, 12);
+  rb_define_module_function(rb_native, "gru_forward", rb_gru_forward, 6);
+  rb_define_module_function(rb_native, "gru_backward", rb_gru_backward, 11);
+}
@@ -1,3 +1,5 @@
 require "mkmf"
 
+have_library("pthread") unless RUBY_PLATFORM =~ /mswin|mingw/
+
 create_makefile("rb_stb_image")
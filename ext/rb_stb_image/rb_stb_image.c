@@ -1,5 +1,12 @@
 #include <ruby.h>
+#include <ruby/thread.h>
 #include <stdint.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <pthread.h>
+#define RB_STB_USE_PTHREAD
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -189,6 +196,166 @@ static VALUE rb_stbir_resize_uint8_srgb_edgemode(VALUE self, VALUE rb_input_pixe
   return rb_ary_new3(2, rb_output_pixels, INT2FIX(result));
 }
 
+typedef struct {
+  const char** filenames;
+  int32_t num_files;
+  int32_t height;
+  int32_t width;
+  int32_t channels;
+  int32_t num_threads;
+  uint8_t* output;
+  int32_t* status;
+  int32_t next_index;
+#ifdef RB_STB_USE_PTHREAD
+  // threads is allocated with the GVL held. The mutex is used only when the helper threads are started.
+  pthread_t* threads;
+  int32_t use_mutex;
+  pthread_mutex_t mutex;
+#endif
+} load_batch_args_t;
+
+static int32_t load_batch_fetch_index(load_batch_args_t* args) {
+  int32_t index;
+#ifdef RB_STB_USE_PTHREAD
+  if (args->use_mutex) pthread_mutex_lock(&args->mutex);
+#endif
+  index = args->next_index++;
+#ifdef RB_STB_USE_PTHREAD
+  if (args->use_mutex) pthread_mutex_unlock(&args->mutex);
+#endif
+  return index;
+}
+
+// Decode one image and write it into its slot of the output buffer, resizing when the size differs.
+static int32_t load_batch_one(load_batch_args_t* args, int32_t index) {
+  const size_t image_size = (size_t)args->height * args->width * args->channels;
+  uint8_t* dest = args->output + image_size * index;
+  int32_t x, y, n;
+  int32_t result = 1;
+  uint8_t* data;
+
+  data = stbi_load(args->filenames[index], &x, &y, &n, args->channels);
+  if (!data) return 0;
+  if (x == args->width && y == args->height) {
+    memcpy(dest, data, image_size);
+  } else {
+    result = stbir_resize_uint8(data, x, y, 0, dest, args->width, args->height, 0, args->channels);
+  }
+  stbi_image_free(data);
+  return result;
+}
+
+static void* load_batch_worker(void* ptr) {
+  load_batch_args_t* args = (load_batch_args_t*)ptr;
+  int32_t index;
+
+  while ((index = load_batch_fetch_index(args)) < args->num_files) {
+    args->status[index] = load_batch_one(args, index);
+  }
+  return NULL;
+}
+
+static void* load_batch_without_gvl(void* ptr) {
+  load_batch_args_t* args = (load_batch_args_t*)ptr;
+#ifdef RB_STB_USE_PTHREAD
+  int32_t num_threads = args->num_threads;
+  int32_t num_started = 0;
+  int32_t i;
+
+  if (num_threads > args->num_files) num_threads = args->num_files;
+  // If the mutex can not be initialized, the calling thread decodes all images.
+  args->use_mutex = num_threads > 1 && pthread_mutex_init(&args->mutex, NULL) == 0;
+  if (!args->use_mutex) num_threads = 1;
+  // The calling thread also works, so only num_threads - 1 helpers are spawned.
+  // If pthread_create fails, the images are decoded by the threads that are already started.
+  for (i = 1; i < num_threads; i++) {
+    if (pthread_create(&args->threads[num_started], NULL, load_batch_worker, args) != 0) break;
+    num_started++;
+  }
+  load_batch_worker(args);
+  for (i = 0; i < num_started; i++) {
+    pthread_join(args->threads[i], NULL);
+  }
+  if (args->use_mutex) pthread_mutex_destroy(&args->mutex);
+#else
+  load_batch_worker(args);
+#endif
+  return NULL;
+}
+
+// Decode and resize many images into one contiguous [num_files, height, width, channels] buffer.
+// Decoding runs on a native thread pool without holding the GVL.
+static VALUE rb_load_batch(VALUE self, VALUE rb_filenames, VALUE rb_height, VALUE rb_width, VALUE rb_channels, VALUE rb_num_threads) {
+  int32_t num_files;
+  int32_t height = FIX2INT(rb_height);
+  int32_t width = FIX2INT(rb_width);
+  int32_t channels = FIX2INT(rb_channels);
+  int32_t num_threads = FIX2INT(rb_num_threads);
+  const char** filenames;
+  int32_t* status;
+  VALUE rb_filenames_str;
+  VALUE rb_output;
+  VALUE rb_failed_indexes;
+  load_batch_args_t args;
+  volatile VALUE filenames_v = 0, status_v = 0;
+#ifdef RB_STB_USE_PTHREAD
+  volatile VALUE threads_v = 0;
+#endif
+  int32_t i;
+
+  Check_Type(rb_filenames, T_ARRAY);
+  num_files = (int32_t)RARRAY_LEN(rb_filenames);
+  if (channels < 1 || channels > 4) rb_raise(rb_eArgError, "channels must be between 1 and 4.");
+  if (height < 1 || width < 1) rb_raise(rb_eArgError, "height and width must be positive.");
+  if (num_threads > num_files) num_threads = num_files;
+  if (num_threads < 1) num_threads = 1;
+
+  // Keep frozen copies of the file names alive so their pointers stay valid while the GVL is released.
+  rb_filenames_str = rb_ary_new_capa(num_files);
+  for (i = 0; i < num_files; i++) {
+    VALUE rb_filename = rb_ary_entry(rb_filenames, i);
+    StringValueCStr(rb_filename);
+    rb_ary_push(rb_filenames_str, rb_str_new_frozen(rb_filename));
+  }
+  // Images are decoded straight into this string, so no per-image buffer is handed back to Ruby.
+  rb_output = rb_str_new(NULL, (long)num_files * height * width * channels);
+  // The tables are Ruby temporary buffers, so an allocation failure raises NoMemoryError before the GVL is released.
+  filenames = rb_alloc_tmp_buffer(&filenames_v, sizeof(const char*) * (num_files > 0 ? num_files : 1));
+  status = rb_alloc_tmp_buffer(&status_v, sizeof(int32_t) * (num_files > 0 ? num_files : 1));
+  for (i = 0; i < num_files; i++) {
+    filenames[i] = RSTRING_PTR(rb_ary_entry(rb_filenames_str, i));
+  }
+
+  args.filenames = filenames;
+  args.num_files = num_files;
+  args.height = height;
+  args.width = width;
+  args.channels = channels;
+  args.num_threads = num_threads;
+  args.output = (uint8_t*)RSTRING_PTR(rb_output);
+  args.status = status;
+  args.next_index = 0;
+#ifdef RB_STB_USE_PTHREAD
+  args.threads = rb_alloc_tmp_buffer(&threads_v, sizeof(pthread_t) * num_threads);
+  args.use_mutex = 0;
+#endif
+  if (num_files > 0) {
+    rb_thread_call_without_gvl(load_batch_without_gvl, &args, NULL, NULL);
+  }
+
+  rb_failed_indexes = rb_ary_new();
+  for (i = 0; i < num_files; i++) {
+    if (!status[i]) rb_ary_push(rb_failed_indexes, INT2FIX(i));
+  }
+  rb_free_tmp_buffer(&filenames_v);
+  rb_free_tmp_buffer(&status_v);
+#ifdef RB_STB_USE_PTHREAD
+  rb_free_tmp_buffer(&threads_v);
+#endif
+  RB_GC_GUARD(rb_filenames_str);
+  return rb_ary_new3(2, rb_output, rb_failed_indexes);
+}
+
 void Init_rb_stb_image() {
   VALUE rb_dnn = rb_define_module("DNN");
   VALUE rb_stb = rb_define_module_under(rb_dnn, "Stb");
@@ -212,4 +379,5 @@ void Init_rb_stb_image() {
   rb_define_module_function(rb_stb, "stbir_resize_uint8", rb_stbir_resize_uint8, 8);
   rb_define_module_function(rb_stb, "stbir_resize_uint8_srgb", rb_stbir_resize_uint8_srgb, 10);
   rb_define_module_function(rb_stb, "stbir_resize_uint8_srgb_edgemode", rb_stbir_resize_uint8_srgb_edgemode, 11);
+  rb_define_module_function(rb_stb, "load_batch", rb_load_batch, 5);
 }
@@ -33,9 +33,20 @@ module DNN
     return false unless ENV["RUBY_DNN_USE_CUDNN"] == "ENABLE"
     cudnn_available?
   end
+
+  # Return true if the native CPU kernels of rb_dnn_native are used.
+  # Set RUBY_DNN_USE_NATIVE=DISABLE to fall back to the pure Ruby implementation.
+  def self.use_native?
+    return false if ENV["RUBY_DNN_USE_NATIVE"] == "DISABLE"
+    !use_cumo? && defined?(DNN::Native) ? true : false
+  end
 end
 
 if RUBY_PLATFORM != "wasm32-wasi"
+  begin
+    require_relative "rb_dnn_native"
+  rescue LoadError
+  end
   require_relative "dnn/version"
   require_relative "dnn/core/monkey_patch"
   require_relative "dnn/core/error"
@@ -44,6 +55,8 @@ if RUBY_PLATFORM != "wasm32-wasi"
   require_relative "dnn/core/tensor"
   require_relative "dnn/core/variable"
   require_relative "dnn/core/link"
+  require_relative "dnn/core/packed_tensor"
+  require_relative "dnn/core/profiler"
   require_relative "dnn/core/iterator"
   require_relative "dnn/core/models"
   require_relative "dnn/core/functions"
@@ -64,4 +77,5 @@ if RUBY_PLATFORM != "wasm32-wasi"
   require_relative "dnn/core/evaluator"
   require_relative "dnn/core/predictor"
   require_relative "dnn/core/trainer"
+  require_relative "dnn/core/frozen_model"
 end
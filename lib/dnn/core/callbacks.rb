@@ -12,6 +12,10 @@ module DNN
       # Process performed after all training.
       # def after_train; end
 
+      # Process performed when the training is stopped by an exception.
+      # @param [Exception] error Raised exception. It is raised again after the callbacks.
+      # def on_train_error(error); end
+
       # Process performed before one training.
       # def before_epoch; end
 
@@ -125,6 +129,43 @@ module DNN
       end
     end
 
+    # A callback that profiles the training with DNN::Profiler.
+    # The following logs will be recorded after each train on batch.
+    # data_time:      Time to fetch the batch.
+    # forward_time:   Time of the forward propagation and the loss.
+    # backward_time:  Time of the backward propagation.
+    # update_time:    Time of the parameter update.
+    class Profile < Callback
+      attr_reader :profiler
+
+      # @param [Boolean] functions Set true to measure the forward and backward of each function.
+      # @param [IO | NilClass] io If given, the summary of the profiler is printed after training.
+      def initialize(functions: true, io: nil)
+        @profiler = Profiler.new(functions: functions)
+        @io = io
+      end
+
+      def before_train
+        @profiler.reset
+        @profiler.start
+      end
+
+      def after_train_on_batch
+        @profiler.take_step_phase_times.each do |phase, time|
+          @runner.add_log(:"#{phase}_time", time)
+        end
+      end
+
+      def after_train
+        @profiler.stop
+        @io&.puts(@profiler.summary)
+      end
+
+      def on_train_error(error)
+        @profiler.stop
+      end
+    end
+
     # A callback that save the log.
     # The following logs will be recorded.
     # epoch:          Current epoch.
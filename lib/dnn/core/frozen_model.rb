@@ -0,0 +1,412 @@
+module DNN
+  # This class runs the inference of a model with a static plan.
+  # The forward pass of the model is recorded once for each input shape, and the plan is replayed
+  # without creating tensors or backward links. BatchNormalization is folded into the preceding
+  # Dense or Conv2D, the bias and activation are fused into one pass over the output, and the
+  # outputs of the fused layers are written into preallocated buffers with rb_dnn_native.
+  # The parameters are copied when the plan is recorded, so later updates of the model are not reflected.
+  class FrozenModel
+    ACTIVATIONS = {
+      Layers::ReLU => :relu,
+      Layers::Sigmoid => :sigmoid,
+      Layers::Tanh => :tanh,
+    }.freeze
+
+    ACTIVATION_FUNCTIONS = {
+      relu: Functions::ReLU,
+      sigmoid: Functions::Sigmoid,
+      tanh: Functions::Tanh,
+    }.freeze
+
+    # One step of a plan. inputs and outputs are slot indexes.
+    # kind is :function, :dense, :conv2d or :affine.
+    Step = Struct.new(:kind, :node, :inputs, :outputs, :multi_outputs, :shape,
+                      :weight, :bias, :scale, :act, :conv, keyword_init: true)
+
+    attr_reader :model
+    attr_reader :max_plans
+
+    # @param [DNN::Models::Model] model Model to freeze. The model must be built.
+    # @param [Integer] max_plans Maximum number of plans to keep. A plan is recorded for each input shape.
+    def initialize(model, max_plans: 8)
+      raise DNNError, "The model is not built." unless model.built?
+      if model.layers.any? { |layer| layer.respond_to?(:stateful) && layer.stateful }
+        raise DNNError, "The model that has a stateful layer can not be frozen."
+      end
+      @model = model
+      @max_plans = max_plans
+      @plans = {}
+      @mutex = Mutex.new
+    end
+
+    # Predict data.
+    # @param [Numo::SFloat | Array] x Input data.
+    # @return [Numo::SFloat | Array] Return the output data or it array.
+    def predict(x)
+      Utils.check_input_data_type("x", x, Xumo::SFloat)
+      xs = x.is_a?(Array) ? x : [x]
+      @mutex.synchronize do
+        plan(xs).run(xs)
+      end
+    end
+
+    # Predict one data.
+    # @param [Numo::SFloat | Array] x Input data. However, x is single data.
+    def predict1(x)
+      Utils.check_input_data_type("x", x, Xumo::SFloat)
+      input = if x.is_a?(Array)
+                x.map { |v| v.reshape(1, *v.shape) }
+              else
+                x.reshape(1, *x.shape)
+              end
+      y = predict(input)
+      if y.is_a?(Array)
+        y.map { |v| v[0, false] }
+      else
+        y[0, false]
+      end
+    end
+
+    # Discard the recorded plans. Call this after the parameters of the model are updated.
+    def clear
+      @mutex.synchronize { @plans.clear }
+    end
+
+    private def plan(xs)
+      key = xs.map(&:shape)
+      plan = @plans.delete(key) || Plan.new(Tracer.new.trace(@model, xs))
+      @plans.delete(@plans.keys.first) if @plans.length >= @max_plans
+      @plans[key] = plan
+    end
+
+    # Record the forward pass of a model.
+    class Tracer
+      THREAD_KEY = :dnn_frozen_model_tracer
+
+      # Number of the traces running on all threads. Layer#call and Function#call check it first,
+      # so that the thread local variable is looked up only while a model is traced.
+      @num_traces = 0
+      @num_traces_mutex = Mutex.new
+
+      # @return [DNN::FrozenModel::Tracer | NilClass] Return the tracer that is recording on this thread.
+      def self.current
+        return nil if @num_traces == 0
+        Thread.current[THREAD_KEY]
+      end
+
+      # Count the trace while the block runs.
+      def self.tracing
+        @num_traces_mutex.synchronize { @num_traces += 1 }
+        begin
+          yield
+        ensure
+          @num_traces_mutex.synchronize { @num_traces -= 1 }
+        end
+      end
+
+      attr_reader :steps
+      attr_reader :values
+      attr_reader :input_slots
+      attr_reader :output_slots
+      attr_reader :multi_outputs
+
+      def initialize
+        @slots = {}.compare_by_identity
+        @computed = []
+        @values = []
+        @steps = []
+        @suspended = 0
+      end
+
+      # @param [DNN::Models::Model] model Model to record.
+      # @param [Array] xs Input data.
+      # @return [DNN::FrozenModel::Tracer] Return self.
+      def trace(model, xs)
+        inputs = xs.map { |x| Tensor.new(x) }
+        @input_slots = inputs.map { |input| new_slot(input) }
+        prev_tracer = Thread.current[THREAD_KEY]
+        layers = model.layers
+        learning_phases = layers.map(&:learning_phase?)
+        Thread.current[THREAD_KEY] = self
+        begin
+          model.set_learning_phase(false)
+          outputs = Tracer.tracing { model.(*inputs) }
+        ensure
+          Thread.current[THREAD_KEY] = prev_tracer
+          layers.zip(learning_phases) { |layer, learning_phase| layer.set_learning_phase(learning_phase) }
+        end
+        @multi_outputs = outputs.is_a?(Array)
+        @output_slots = (@multi_outputs ? outputs : [outputs]).map { |output| slot(output) }
+        self
+      end
+
+      # @param [Integer] slot Slot index.
+      # @return [Boolean] Return true if the value of the slot is computed from the inputs.
+      def computed?(slot)
+        @computed[slot]
+      end
+
+      # Called by Layer#call. A supported layer is recorded as one step, and the functions
+      # called in its forward are not recorded.
+      def record_layer(layer, inputs)
+        return yield if @suspended > 0 || inputs.length != 1 || !computed_tensor?(inputs[0])
+        step = layer_step(layer, inputs[0])
+        return yield unless step
+        @suspended += 1
+        begin
+          output = yield
+        ensure
+          @suspended -= 1
+        end
+        step.inputs = [slot(inputs[0])]
+        step.outputs = [new_slot(output)]
+        step.shape = output.shape
+        @steps << step
+        output
+      end
+
+      # Called by Function#call. Functions whose inputs are all constant are not recorded,
+      # and their outputs are treated as constants.
+      def record_function(node, inputs, outputs)
+        return if @suspended > 0 || inputs.none? { |input| computed_tensor?(input) }
+        multi_outputs = outputs.is_a?(Array)
+        @steps << Step.new(kind: :function, node: node,
+                           inputs: inputs.map { |input| input && slot(input) },
+                           outputs: (multi_outputs ? outputs : [outputs]).map { |output| new_slot(output) },
+                           multi_outputs: multi_outputs)
+      end
+
+      private def computed_tensor?(tensor)
+        tensor && @slots.key?(tensor) && @computed[@slots[tensor]]
+      end
+
+      private def new_slot(tensor)
+        @slots[tensor] = @values.length
+        @values << nil
+        @computed << true
+        @slots[tensor]
+      end
+
+      # A tensor that is not computed from the inputs is a constant, and its data is copied.
+      private def slot(tensor)
+        return @slots[tensor] if @slots.key?(tensor)
+        @slots[tensor] = @values.length
+        @values << tensor.data.dup
+        @computed << false
+        @slots[tensor]
+      end
+
+      private def layer_step(layer, x)
+        if layer.instance_of?(Layers::Dense)
+          return nil unless x.shape.length == 2
+          Step.new(kind: :dense, weight: layer.weight.data.dup, bias: layer.bias&.data&.dup)
+        elsif layer.instance_of?(Layers::Conv2D)
+          conv = { img_shape: x.shape, filter_size: layer.filter_size, strides: layer.strides, pad: layer.pad_size }
+          Step.new(kind: :conv2d, weight: layer.weight.data.dup, bias: layer.bias&.data&.dup, conv: conv)
+        elsif layer.instance_of?(Layers::BatchNormalization)
+          return nil unless layer.axis == 0
+          scale = layer.gamma.data / Xumo::NMath.sqrt(layer.running_var.data + layer.eps)
+          shift = layer.beta.data - layer.running_mean.data * scale
+          Step.new(kind: :affine, scale: scale.flatten, bias: shift.flatten)
+        elsif ACTIVATIONS[layer.class]
+          Step.new(kind: :affine, act: ACTIVATIONS[layer.class])
+        end
+      end
+    end
+
+    # A recorded plan for one input shape.
+    class Plan
+      attr_reader :steps
+
+      # @param [DNN::FrozenModel::Tracer] tracer Tracer that recorded the forward pass.
+      def initialize(tracer)
+        @values = tracer.values
+        @computed_slots = @values.each_index.select { |slot| tracer.computed?(slot) }
+        @input_slots = tracer.input_slots
+        @output_slots = tracer.output_slots
+        @multi_outputs = tracer.multi_outputs
+        @native = DNN.use_native? && Native.respond_to?(:dense_forward)
+        @steps = fuse_steps(tracer.steps)
+        @buffers = {}
+        @buffered_slots = []
+        allocate_buffers if @native
+      end
+
+      # @param [Array] xs Input data.
+      # @return [Numo::SFloat | Array] Return the output data or it array.
+      def run(xs)
+        @input_slots.each.with_index do |slot, i|
+          @values[slot] = xs[i]
+        end
+        @steps.each.with_index do |step, i|
+          run_step(step, @buffers[i])
+        end
+        ys = @output_slots.map do |slot|
+          @buffered_slots[slot] ? @values[slot].dup : @values[slot]
+        end
+        @computed_slots.each { |slot| @values[slot] = nil }
+        @multi_outputs ? ys : ys[0]
+      end
+
+      private def run_step(step, buffer)
+        if step.kind == :function
+          ys = step.node.forward(*step.inputs.map { |slot| slot && @values[slot] })
+          ys = [ys] unless step.multi_outputs
+          step.outputs.each.with_index do |slot, i|
+            @values[slot] = ys[i]
+          end
+          return
+        end
+        x = @values[step.inputs[0]]
+        @values[step.outputs[0]] = if @native
+                                     run_native_step(step, contiguous(x), buffer)
+                                   else
+                                     run_xumo_step(step, x)
+                                   end
+      end
+
+      private def run_native_step(step, x, out)
+        case step.kind
+        when :dense
+          Native.dense_forward(x, step.weight, step.scale, step.bias, step.act, out,
+                               [x.shape[0], x.shape[1], step.weight.shape[1]])
+        when :conv2d
+          conv = step.conv
+          Native.conv2d_forward(x, step.weight, step.scale, step.bias, step.act, @col, out,
+                                x.shape, step.shape[1..2], conv[:filter_size], conv[:strides], conv[:pad])
+        when :affine
+          Native.affine_forward(x, step.scale, step.bias, step.act, out)
+        end
+      end
+
+      private def run_xumo_step(step, x)
+        case step.kind
+        when :dense
+          y = x.dot(step.weight)
+        when :conv2d
+          conv = step.conv
+          col = Functions::Conv2DFunctionUtils.im2col(x, *step.shape[1..2], *conv[:filter_size], conv[:strides], conv[:pad])
+          y = col.dot(step.weight).reshape(*step.shape)
+        when :affine
+          y = x
+        end
+        y = broadcast_op(y, step.scale, :*) if step.scale
+        y = broadcast_op(y, step.bias, :+) if step.bias
+        y = ACTIVATION_FUNCTIONS[step.act].new.forward(y) if step.act
+        y
+      end
+
+      # Apply op with the flat param that is repeated over the trailing elements of y.
+      private def broadcast_op(y, param, op)
+        y2 = contiguous(y).reshape(y.size / param.size, param.size)
+        y2.send(op, param).reshape(*y.shape)
+      end
+
+      private def contiguous(x)
+        x.contiguous? ? x : x.dup
+      end
+
+      # Fold a BatchNormalization or an activation into the Dense or Conv2D step that produces its input.
+      private def fuse_steps(steps)
+        num_consumers = Hash.new(0)
+        steps.each do |step|
+          step.inputs.each { |slot| num_consumers[slot] += 1 if slot }
+        end
+        @output_slots.each { |slot| num_consumers[slot] += 1 }
+        producers = {}
+        fused_steps = []
+        steps.each do |step|
+          prev_step = step.kind == :affine ? producers[step.inputs[0]] : nil
+          if prev_step && num_consumers[step.inputs[0]] == 1 && !prev_step.act && fuse_step(prev_step, step)
+            prev_step.outputs = step.outputs
+            producers[step.outputs[0]] = prev_step
+          else
+            fused_steps << step
+            producers[step.outputs[0]] = step unless step.kind == :function
+          end
+        end
+        fused_steps
+      end
+
+      private def fuse_step(prev_step, step)
+        if step.scale
+          return false if prev_step.scale || prev_step.kind == :affine
+          if prev_step.kind == :dense
+            prev_step.weight = prev_step.weight * step.scale
+            prev_step.bias = prev_step.bias ? prev_step.bias * step.scale + step.bias : step.bias
+          else
+            fold_conv2d_affine(prev_step, step)
+          end
+        end
+        prev_step.act = step.act
+        true
+      end
+
+      # The statistics of BatchNormalization are held for each element of [out_h, out_w, num_filters].
+      # The scale is folded into the weight only if it is the same at every position.
+      private def fold_conv2d_affine(prev_step, step)
+        num_filters = prev_step.weight.shape[1]
+        scale = step.scale.reshape(step.scale.size / num_filters, num_filters)
+        bias = step.bias.reshape(*scale.shape)
+        bias += prev_step.bias * scale if prev_step.bias
+        if uniform?(scale)
+          prev_step.weight = prev_step.weight * scale[0, true]
+        else
+          prev_step.scale = scale.flatten
+        end
+        prev_step.bias = uniform?(bias) ? bias[0, true].dup : bias.flatten
+      end
+
+      private def uniform?(params)
+        Utils.to_f((params - params[0, true]).abs.max) == 0
+      end
+
+      # Allocate the output buffers of the fused steps. A buffer is reused by a later step of the same shape
+      # after the last step that reads it. The outputs of function steps may be views of their inputs,
+      # so they keep the buffers of their inputs alive.
+      private def allocate_buffers
+        last_uses = {}
+        @steps.each.with_index do |step, i|
+          step.inputs.each { |slot| last_uses[slot] = i if slot }
+        end
+        @output_slots.each { |slot| last_uses[slot] = @steps.length }
+        roots = Hash.new { [] }
+        buffer_last_uses = {}
+        @steps.each.with_index do |step, i|
+          if step.kind == :function
+            step.outputs.each { |slot| roots[slot] = step.inputs.flat_map { |input| roots[input] }.uniq }
+          else
+            roots[step.outputs[0]] = [i]
+          end
+          step.outputs.each do |slot|
+            roots[slot].each do |root|
+              buffer_last_uses[root] = [buffer_last_uses[root] || i, last_uses[slot] || i].max
+            end
+          end
+        end
+        @output_slots.each { |slot| @buffered_slots[slot] = !roots[slot].empty? }
+        free_buffers = Hash.new { |h, k| h[k] = [] }
+        live_buffers = []
+        col_size = 0
+        @steps.each.with_index do |step, i|
+          live_buffers.reject! do |root|
+            next false if buffer_last_uses[root] >= i
+            free_buffers[@steps[root].shape] << @buffers[root]
+            true
+          end
+          next if step.kind == :function
+          @buffers[i] = free_buffers[step.shape].pop || Xumo::SFloat.new(*step.shape)
+          live_buffers << i
+          col_size = [col_size, conv_col_size(step)].max if step.kind == :conv2d
+        end
+        @col = Xumo::SFloat.new(col_size) if col_size > 0
+      end
+
+      private def conv_col_size(step)
+        conv = step.conv
+        bsize, out_h, out_w = *step.shape
+        bsize * out_h * out_w * conv[:filter_size].reduce(:*) * conv[:img_shape][3]
+      end
+    end
+  end
+end
@@ -7,7 +7,12 @@ module DNN
 
       def call(*inputs)
         xs = inputs.map(&:data)
-        ys = forward(*xs)
+        profiler = Profiler.current
+        ys = if profiler&.functions?
+               profiler.measure_function(self, :forward) { forward(*xs) }
+             else
+               forward(*xs)
+             end
         num_outputs = (ys.is_a?(Array) ? ys.length : 1)
         if inputs.find { |prev| prev && prev.requires_grad }
           link = Link.new(prevs: inputs, node: self, num_outputs: num_outputs)
@@ -17,11 +22,13 @@ module DNN
         else
           link = nil
         end
-        if ys.is_a?(Array)
-          ys.map.with_index { |y, i| Tensor.new(y, prev_link: link, backward_index: i) }
-        else
-          Tensor.new(ys, prev_link: link, backward_index: 0)
-        end
+        outputs = if ys.is_a?(Array)
+                    ys.map.with_index { |y, i| Tensor.new(y, prev_link: link, backward_index: i) }
+                  else
+                    Tensor.new(ys, prev_link: link, backward_index: 0)
+                  end
+        FrozenModel::Tracer.current&.record_function(self, inputs, outputs)
+        outputs
       end
 
       def forward(*xs)
@@ -5,24 +5,43 @@ module DNN
       module_function
 
       # img[bsize, out_h, out_w, ch] to col[bsize * out_h * out_w, fil_h * fil_w * ch]
+      # If pad is given, img is zero padded by pad before it is converted.
       def im2col(*args)
         if DNN.use_cumo?
           im2col_gpu(*args)
+        elsif DNN.use_native? && args[0].is_a?(Numo::SFloat)
+          im2col_native(*args)
         else
           im2col_cpu(*args)
         end
       end
 
       # col[bsize * out_h * out_w, fil_h * fil_w * ch] to img[bsize, out_h, out_w, ch]
+      # If pad is given, img_shape is the shape before padding and the padding is cropped from the result.
       def col2im(*args)
         if DNN.use_cumo?
           col2im_gpu(*args)
+        elsif DNN.use_native? && args[0].is_a?(Numo::SFloat)
+          col2im_native(*args)
         else
           col2im_cpu(*args)
         end
       end
 
-      def im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides)
+      def im2col_native(img, out_h, out_w, fil_h, fil_w, strides, pad = nil)
+        bsize = img.shape[0]
+        ch = img.shape[3]
+        bin = Native.im2col(img.to_binary, img.shape, [out_h, out_w], [fil_h, fil_w], strides, pad || [0, 0])
+        Numo::SFloat.from_binary(bin, [bsize * out_h * out_w, fil_h * fil_w * ch])
+      end
+
+      def col2im_native(col, img_shape, out_h, out_w, fil_h, fil_w, strides, pad = nil)
+        bin = Native.col2im(col.to_binary, img_shape, [out_h, out_w], [fil_h, fil_w], strides, pad || [0, 0])
+        Numo::SFloat.from_binary(bin, img_shape)
+      end
+
+      def im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides, pad = nil)
+        img = zero_padding(img, pad) if pad
         bsize = img.shape[0]
         ch = img.shape[3]
         col = img.class.zeros(bsize, out_h, out_w, fil_h, fil_w, ch)
@@ -36,14 +55,18 @@ module DNN
         col.reshape(bsize * out_h * out_w, fil_h * fil_w * ch)
       end
 
-      def im2col_gpu(img, out_h, out_w, fil_h, fil_w, strides)
+      def im2col_gpu(img, out_h, out_w, fil_h, fil_w, strides, pad = nil)
         img = Utils.cumo2numo(img)
-        col = im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides)
+        col = im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides, pad)
         Utils.numo2cumo(col)
       end
 
-      def col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
+      def col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides, pad = nil)
         bsize, img_h, img_w, ch = img_shape
+        if pad
+          img_h += pad[0]
+          img_w += pad[1]
+        end
         col = col.reshape(bsize, out_h, out_w, fil_h, fil_w, ch)
         img = col.class.zeros(bsize, img_h, img_w, ch)
         (0...fil_h).each do |i|
@@ -53,12 +76,12 @@ module DNN
             img[true, i_range, j_range, true] += col[true, true, true, i, j, true]
           end
         end
-        img
+        pad ? zero_padding_bwd(img, pad) : img
       end
 
-      def col2im_gpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
+      def col2im_gpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides, pad = nil)
         col = Utils.cumo2numo(col)
-        img = col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
+        img = col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides, pad)
         Utils.numo2cumo(img)
       end
 
@@ -100,9 +123,8 @@ module DNN
       def forward(x, weight, bias = nil)
         @weight = weight
         @bias = bias
-        x = zero_padding(x, @pad_size) if @padding
         @x_shape = x.shape
-        @col = im2col(x, *@out_size, *@filter_size, @strides)
+        @col = im2col(x, *@out_size, *@filter_size, @strides, @padding ? @pad_size : nil)
         y = @col.dot(weight)
         y += bias if bias
         y.reshape(x.shape[0], *@out_size, y.shape[3])
@@ -115,8 +137,7 @@ module DNN
           dbias = dy.sum(0) if @bias
         end
         dcol = dy.dot(@weight.transpose)
-        dx = col2im(dcol, @x_shape, *@out_size, *@filter_size, @strides)
-        dx = @padding ? zero_padding_bwd(dx, @pad_size) : dx
+        dx = col2im(dcol, @x_shape, *@out_size, *@filter_size, @strides, @padding ? @pad_size : nil)
         if @bias
           [dx, dweight, dbias]
         else
@@ -148,15 +169,14 @@ module DNN
         x = x.reshape(x.shape[0..2].reduce(:*), x.shape[3])
         @x = x
         col = x.dot(@weight.transpose)
-        img_shape = [bsize, @out_size[0] + @pad_size[0], @out_size[1] + @pad_size[1], @num_filters]
-        y = col2im(col, img_shape, *@x_shape[1..2], *@filter_size, @strides)
+        img_shape = [bsize, *@out_size, @num_filters]
+        y = col2im(col, img_shape, *@x_shape[1..2], *@filter_size, @strides, @padding ? @pad_size : nil)
         y += @bias if @bias
-        @padding ? zero_padding_bwd(y, @pad_size) : y
+        y
       end
 
       def backward(dy)
-        dy = zero_padding(dy, @pad_size) if @padding
-        col = im2col(dy, *@x_shape[1..2], *@filter_size, @strides)
+        col = im2col(dy, *@x_shape[1..2], *@filter_size, @strides, @padding ? @pad_size : nil)
         if @trainable
           dweight = col.transpose.dot(@x)
           dbias = col.reshape(col.shape[0] * @filter_size.reduce(:*), @num_filters).sum(0) if @bias
@@ -189,9 +209,8 @@ module DNN
 
     class MaxPool2D < Pool2D
       def forward(x)
-        x = zero_padding(x, @pad_size) if @padding
         @x_shape = x.shape
-        col = im2col(x, *@out_size, *@pool_size, @strides)
+        col = im2col(x, *@out_size, *@pool_size, @strides, @padding ? @pad_size : nil)
         col = col.reshape(x.shape[0] * @out_size.reduce(:*), @pool_size.reduce(:*), x.shape[3])
         @max_index = col.max_index(1)
         col.max(1).reshape(x.shape[0], *@out_size, x.shape[3])
@@ -201,16 +220,14 @@ module DNN
         dmax = Xumo::SFloat.zeros(dy.size * @pool_size.reduce(:*))
         dmax[@max_index.flatten] = dy.flatten
         dcol = dmax.reshape(dy.shape[0..2].reduce(:*), @pool_size.reduce(:*) * dy.shape[3])
-        dx = col2im(dcol, @x_shape, *@out_size, *@pool_size, @strides)
-        @padding ? zero_padding_bwd(dx, @pad_size) : dx
+        col2im(dcol, @x_shape, *@out_size, *@pool_size, @strides, @padding ? @pad_size : nil)
       end
     end
 
     class AvgPool2D < Pool2D
       def forward(x)
-        x = zero_padding(x, @pad_size) if @padding
         @x_shape = x.shape
-        col = im2col(x, *@out_size, *@pool_size, @strides)
+        col = im2col(x, *@out_size, *@pool_size, @strides, @padding ? @pad_size : nil)
         col = col.reshape(x.shape[0] * @out_size.reduce(:*), @pool_size.reduce(:*), x.shape[3])
         col.mean(1).reshape(x.shape[0], *@out_size, x.shape[3])
       end
@@ -223,8 +240,7 @@ module DNN
           davg[true, i] = dy.flatten
         end
         dcol = davg.reshape(dy.shape[0..2].reduce(:*), dy.shape[3] * @pool_size.reduce(:*))
-        dx = col2im(dcol, @x_shape, *@out_size, *@pool_size, @strides)
-        @padding ? zero_padding_bwd(dx, @pad_size) : dx
+        col2im(dcol, @x_shape, *@out_size, *@pool_size, @strides, @padding ? @pad_size : nil)
       end
     end
 
@@ -289,38 +305,42 @@ module DNN
     class Im2col < Function
       include Conv2DFunctionUtils
 
-      def initialize(out_size, filter_size, strides)
+      # @param [Array | NilClass] pad_size If given, the input is zero padded by pad_size before conversion.
+      def initialize(out_size, filter_size, strides, pad_size = nil)
         @out_size = out_size
         @filter_size = filter_size
         @strides = strides
+        @pad_size = pad_size
       end
 
       def forward(x)
         @x_shape = x.shape
-        im2col(x, *@out_size, *@filter_size, @strides)
+        im2col(x, *@out_size, *@filter_size, @strides, @pad_size)
       end
 
       def backward(dy)
-        col2im(dy, @x_shape, *@out_size, *@filter_size, @strides)
+        col2im(dy, @x_shape, *@out_size, *@filter_size, @strides, @pad_size)
       end
     end
 
     class Col2im < Function
       include Conv2DFunctionUtils
 
-      def initialize(img_shape, in_size, filter_size, strides)
+      # @param [Array | NilClass] pad_size If given, pad_size is cropped from the output and img_shape is the cropped shape.
+      def initialize(img_shape, in_size, filter_size, strides, pad_size = nil)
         @img_shape = img_shape
         @in_size = in_size
         @filter_size = filter_size
         @strides = strides
+        @pad_size = pad_size
       end
 
       def forward(x)
-        col2im(x, @img_shape, *@in_size, *@filter_size, @strides)
+        col2im(x, @img_shape, *@in_size, *@filter_size, @strides, @pad_size)
       end
 
       def backward(dy)
-        im2col(dy, *@in_size, *@filter_size, @strides)
+        im2col(dy, *@in_size, *@filter_size, @strides, @pad_size)
       end
     end
 
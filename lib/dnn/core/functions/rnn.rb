@@ -212,5 +212,88 @@ module DNN
       end
     end
 
+    # Run LSTM over the whole sequence with the native kernel of rb_dnn_native.
+    class LSTM < Function
+      attr_reader :h
+      attr_reader :c
+
+      # @param [Boolean] return_sequences Set the false, only the last h is returned.
+      def initialize(return_sequences: true)
+        @return_sequences = return_sequences
+      end
+
+      def call(xs, h, c, weight, recurrent_weight, bias = nil)
+        @requires_dxs = xs.requires_grad
+        super(*[xs, h, c, weight, recurrent_weight, bias].compact)
+      end
+
+      def forward(xs, h, c, weight, recurrent_weight, bias = nil)
+        @dims = [*xs.shape, h.shape[1]]
+        @bins = [xs, h, c, weight, recurrent_weight].map(&:to_binary)
+        @use_bias = bias ? true : false
+        @hs, @cs, @gates = Native.lstm_forward(*@bins, bias&.to_binary, @dims)
+        bsize, time, _, num_units = @dims
+        hs = Xumo::SFloat.from_binary(@hs, [bsize, time, num_units])
+        @h = hs[true, -1, true].dup
+        @c = Xumo::SFloat.from_binary(@cs, [bsize, time, num_units])[true, -1, true].dup
+        @return_sequences ? hs : @h
+      end
+
+      def backward(dy)
+        dxs, dh, dc, dweight, drecurrent_weight, dbias = Native.lstm_backward(
+          *@bins, @hs, @cs, @gates, dy.to_binary, @dims, @return_sequences, @requires_dxs)
+        bsize, time, in_dim, num_units = @dims
+        grads = [
+          dxs && Xumo::SFloat.from_binary(dxs, [bsize, time, in_dim]),
+          Xumo::SFloat.from_binary(dh, [bsize, num_units]),
+          Xumo::SFloat.from_binary(dc, [bsize, num_units]),
+          Xumo::SFloat.from_binary(dweight, [in_dim, num_units * 4]),
+          Xumo::SFloat.from_binary(drecurrent_weight, [num_units, num_units * 4]),
+        ]
+        grads << Xumo::SFloat.from_binary(dbias, [num_units * 4]) if @use_bias
+        grads
+      end
+    end
+
+    # Run GRU over the whole sequence with the native kernel of rb_dnn_native.
+    class GRU < Function
+      attr_reader :h
+
+      # @param [Boolean] return_sequences Set the false, only the last h is returned.
+      def initialize(return_sequences: true)
+        @return_sequences = return_sequences
+      end
+
+      def call(xs, h, weight, recurrent_weight, bias = nil)
+        @requires_dxs = xs.requires_grad
+        super(*[xs, h, weight, recurrent_weight, bias].compact)
+      end
+
+      def forward(xs, h, weight, recurrent_weight, bias = nil)
+        @dims = [*xs.shape, h.shape[1]]
+        @bins = [xs, h, weight, recurrent_weight].map(&:to_binary)
+        @use_bias = bias ? true : false
+        @hs, @gates, @hr = Native.gru_forward(*@bins, bias&.to_binary, @dims)
+        bsize, time, _, num_units = @dims
+        hs = Xumo::SFloat.from_binary(@hs, [bsize, time, num_units])
+        @h = hs[true, -1, true].dup
+        @return_sequences ? hs : @h
+      end
+
+      def backward(dy)
+        dxs, dh, dweight, drecurrent_weight, dbias = Native.gru_backward(
+          *@bins, @hs, @gates, @hr, dy.to_binary, @dims, @return_sequences, @requires_dxs)
+        bsize, time, in_dim, num_units = @dims
+        grads = [
+          dxs && Xumo::SFloat.from_binary(dxs, [bsize, time, in_dim]),
+          Xumo::SFloat.from_binary(dh, [bsize, num_units]),
+          Xumo::SFloat.from_binary(dweight, [in_dim, num_units * 3]),
+          Xumo::SFloat.from_binary(drecurrent_weight, [num_units, num_units * 3]),
+        ]
+        grads << Xumo::SFloat.from_binary(dbias, [num_units * 3]) if @use_bias
+        grads
+      end
+    end
+
   end
 end
@@ -66,13 +66,15 @@ module DNN
     # @param [Array] datas input datas.
     # @param [Boolean] random Set true to return batches randomly. Setting false returns batches in order of index.
     # @param [Boolean] last_round_down Set true to round down for last batch data when call foreach.
-    def initialize(*datas, random: true, last_round_down: false)
+    # @param [Integer | NilClass] seed Seed used to shuffle the indexes. If nil, the global random generator is used.
+    def initialize(*datas, random: true, last_round_down: false, seed: nil)
       super(last_round_down: last_round_down)
       datas.each.with_index do |data, i|
         Utils.check_input_data_type("datas[#{i}]", data, Xumo::NArray)
       end
       @datas = datas
       @random = random
+      @rng = seed ? Random.new(seed) : Random
       @num_datas = datas[0].is_a?(Array) ? datas[0][0].shape[0] : datas[0].shape[0]
       reset
     end
@@ -109,7 +111,210 @@ module DNN
     def reset
       @has_next = true
       @indexes = @num_datas.times.to_a
-      @indexes.shuffle! if @random
+      @indexes.shuffle!(random: @rng) if @random
+    end
+  end
+
+
+  # This class reads input datas and output datas from packed tensor files.
+  # The files are memory mapped, so datasets larger than memory can be used and each batch
+  # is gathered directly from the mapped pages.
+  class MmapIterator < BaseIterator
+    # @param [Array] file_names Packed tensor file names. An element can be an Array of file names for multiple inputs.
+    # @param [Boolean] random Set true to return batches randomly. Setting false returns batches in order of index.
+    # @param [Boolean] last_round_down Set true to round down for last batch data when call foreach.
+    # @param [Integer | NilClass] seed Seed used to shuffle the indexes. If nil, the global random generator is used.
+    def initialize(*file_names, random: true, last_round_down: false, seed: nil)
+      super(last_round_down: last_round_down)
+      @readers = file_names.map do |file_name|
+        if file_name.is_a?(Array)
+          file_name.map { |name| PackedTensor::Reader.new(name, random: random) }
+        else
+          PackedTensor::Reader.new(file_name, random: random)
+        end
+      end
+      @random = random
+      @rng = seed ? Random.new(seed) : Random
+      @num_datas = @readers.flatten[0].num_samples
+      @readers.flatten.each do |reader|
+        unless reader.num_samples == @num_datas
+          raise DNNError, "The number of samples is mismatch. #{reader.num_samples} != #{@num_datas}."
+        end
+      end
+      reset
+    end
+
+    # Return the next batch.
+    # @param [Integer] batch_size Required batch size.
+    # @return [Array] Returns the mini batch in the form (*batches).
+    def next_batch(batch_size)
+      check_next_batch
+      if @indexes.length <= batch_size
+        batch_indexes = @indexes
+        @has_next = false
+      else
+        batch_indexes = @indexes.shift(batch_size)
+      end
+      get_batch(batch_indexes)
+    end
+
+    # Reset input datas and output datas.
+    def reset
+      @has_next = true
+      @indexes = @num_datas.times.to_a
+      @indexes.shuffle!(random: @rng) if @random
+    end
+
+    # Unmap the files.
+    def close
+      @readers.flatten.each(&:close)
+    end
+
+    private def get_batch(batch_indexes)
+      @readers.map do |reader|
+        if reader.is_a?(Array)
+          reader.map { |r| r.gather(batch_indexes) }
+        else
+          reader.gather(batch_indexes)
+        end
+      end
+    end
+  end
+
+
+  # This class prepares the next batches of another iterator in the background.
+  # The batches are returned in exactly the same order as the wrapped iterator returns them,
+  # so the results do not change except that data preparation overlaps with training.
+  class PrefetchIterator < BaseIterator
+    # @param [DNN::BaseIterator] iterator Iterator to prefetch.
+    # @param [Integer] num_prefetch Number of batches to prepare in advance.
+    # @param [Symbol] worker Specify :thread or :process.
+    #                        :thread runs the wrapped iterator in a thread. This is effective when the
+    #                        batch preparation releases the GVL like DNN::MmapIterator and DNN::Image.read_batch.
+    #                        :process runs the wrapped iterator in a forked process and receives the batches through a pipe.
+    def initialize(iterator, num_prefetch: 2, worker: :thread)
+      super(last_round_down: iterator.last_round_down)
+      raise DNNError, "num_prefetch must be greater than 0." unless num_prefetch > 0
+      case worker
+      when :thread
+      when :process
+        raise DNNError, "worker :process is not supported on this platform." unless Process.respond_to?(:fork)
+        raise DNNError, "worker :process is not supported when using Cumo." if DNN.use_cumo?
+      else
+        raise DNNError, "worker: #{worker} is not supported."
+      end
+      @iterator = iterator
+      @num_prefetch = num_prefetch
+      @worker = worker
+      @num_datas = iterator.num_datas
+      @has_next = iterator.has_next?
+      @queue = nil
+      @worker_thread = nil
+      @pid = nil
+      @batch_size = nil
+    end
+
+    # Return the next batch.
+    # @param [Integer] batch_size Required batch size.
+    # @return [Array] Returns the mini batch in the form (*batches).
+    def next_batch(batch_size)
+      check_next_batch
+      start_worker(batch_size) unless @queue
+      unless batch_size == @batch_size
+        raise DNNError, "batch_size is #{batch_size}, but batches of size #{@batch_size} are prefetched. Please call reset."
+      end
+      item = @queue.pop
+      raise item if item.is_a?(Exception)
+      batches, @has_next = item
+      batches
+    end
+
+    # Stop prefetching and reset the wrapped iterator.
+    def reset
+      stop_worker
+      @iterator.reset
+      @has_next = @iterator.has_next?
+    end
+
+    # Stop prefetching.
+    def close
+      stop_worker
+    end
+
+    private def start_worker(batch_size)
+      @batch_size = batch_size
+      @queue = SizedQueue.new(@num_prefetch)
+      if @worker == :process
+        start_process_worker
+      else
+        start_thread_worker
+      end
+    end
+
+    private def start_thread_worker
+      queue = @queue
+      @worker_thread = Thread.new do
+        while @iterator.has_next?
+          batches = @iterator.next_batch(@batch_size)
+          queue.push([batches, @iterator.has_next?])
+        end
+      rescue ClosedQueueError
+      rescue => e
+        queue.push(e) rescue ClosedQueueError
+      end
+      @worker_thread.report_on_exception = false
+    end
+
+    # The wrapped iterator in this process is not advanced, because the forked process iterates over its copy.
+    # Reset restarts the worker from the state after @iterator.reset.
+    private def start_process_worker
+      reader, writer = IO.pipe
+      @pid = fork do
+        reader.close
+        begin
+          while @iterator.has_next?
+            batches = @iterator.next_batch(@batch_size)
+            Marshal.dump([batches, @iterator.has_next?], writer)
+          end
+        rescue => e
+          Marshal.dump(DNNError.new("#{e.class}: #{e.message}"), writer) rescue nil
+        ensure
+          writer.close
+          exit!(0)
+        end
+      end
+      Process.detach(@pid)
+      writer.close
+      queue = @queue
+      @worker_thread = Thread.new do
+        loop do
+          item = Marshal.load(reader)
+          queue.push(item)
+          break if item.is_a?(Exception) || !item[1]
+        end
+      rescue ClosedQueueError
+      rescue => e
+        queue.push(e) rescue ClosedQueueError
+      ensure
+        reader.close
+      end
+      @worker_thread.report_on_exception = false
+    end
+
+    private def stop_worker
+      return unless @queue
+      @queue.close
+      @queue.clear
+      if @pid
+        begin
+          Process.kill(:TERM, @pid)
+        rescue Errno::ESRCH
+        end
+        @pid = nil
+      end
+      @worker_thread.join
+      @worker_thread = nil
+      @queue = nil
     end
   end
 end
@@ -25,7 +25,9 @@ module DNN
       def call(*inputs)
         inputs.compact!
         build(*inputs.map { |input| input.shape[1..-1] }) unless built?
-        forward(*inputs)
+        tracer = FrozenModel::Tracer.current
+        return forward(*inputs) unless tracer
+        tracer.record_layer(self, inputs) { forward(*inputs) }
       end
 
       # Build the layer.
@@ -7,60 +7,12 @@ module DNN
 
       # img[bsize, out_h, out_w, ch] to col[bsize * out_h * out_w, fil_h * fil_w * ch]
       def im2col(*args)
-        if DNN.use_cumo?
-          im2col_gpu(*args)
-        else
-          im2col_cpu(*args)
-        end
+        Functions::Conv2DFunctionUtils.im2col(*args)
       end
 
       # col[bsize * out_h * out_w, fil_h * fil_w * ch] to img[bsize, out_h, out_w, ch]
       def col2im(*args)
-        if DNN.use_cumo?
-          col2im_gpu(*args)
-        else
-          col2im_cpu(*args)
-        end
-      end
-
-      def im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides)
-        bsize = img.shape[0]
-        ch = img.shape[3]
-        col = img.class.zeros(bsize, out_h, out_w, fil_h, fil_w, ch)
-        (0...fil_h).each do |i|
-          i_range = (i...(i + strides[0] * out_h)).step(strides[0]).to_a
-          (0...fil_w).each do |j|
-            j_range = (j...(j + strides[1] * out_w)).step(strides[1]).to_a
-            col[true, true, true, i, j, true] = img[true, i_range, j_range, true]
-          end
-        end
-        col.reshape(bsize * out_h * out_w, fil_h * fil_w * ch)
-      end
-
-      def im2col_gpu(img, out_h, out_w, fil_h, fil_w, strides)
-        img = Utils.cumo2numo(img)
-        col = im2col_cpu(img, out_h, out_w, fil_h, fil_w, strides)
-        Utils.numo2cumo(col)
-      end
-
-      def col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
-        bsize, img_h, img_w, ch = img_shape
-        col = col.reshape(bsize, out_h, out_w, fil_h, fil_w, ch)
-        img = col.class.zeros(bsize, img_h, img_w, ch)
-        (0...fil_h).each do |i|
-          i_range = (i...(i + strides[0] * out_h)).step(strides[0]).to_a
-          (0...fil_w).each do |j|
-            j_range = (j...(j + strides[1] * out_w)).step(strides[1]).to_a
-            img[true, i_range, j_range, true] += col[true, true, true, i, j, true]
-          end
-        end
-        img
-      end
-
-      def col2im_gpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
-        col = Utils.cumo2numo(col)
-        img = col2im_cpu(col, img_shape, out_h, out_w, fil_h, fil_w, strides)
-        Utils.numo2cumo(img)
+        Functions::Conv2DFunctionUtils.col2im(*args)
       end
 
       def zero_padding(img, pad)
@@ -118,6 +70,7 @@ module DNN
       attr_reader :filter_size
       attr_reader :strides
       attr_reader :padding
+      attr_reader :pad_size
 
       # @param [Integer] num_filters Number of filters.
       # @param [Array | Integer] filter_size Filter size. Filter size is of the form [height, width].
@@ -160,8 +113,7 @@ module DNN
 
       def forward(x)
         batch_size = x.shape[0]
-        x = Functions::ZeroPadding2D.new(@pad_size).(x) if @padding
-        x = Functions::Im2col.new(@out_size, @filter_size, @strides).(x)
+        x = Functions::Im2col.new(@out_size, @filter_size, @strides, @padding ? @pad_size : nil).(x)
         x = x.dot(@weight)
         x += @bias if @bias
         Functions::FunctionSpace.reshape(x, [batch_size, *@out_size, x.shape[3]])
@@ -250,10 +202,9 @@ module DNN
         bsize = x.shape[0]
         x = x.reshape(x.shape[0..2].reduce(:*), x.shape[3])
         col = x.dot(@weight.transpose)
-        img_shape = [bsize, @out_size[0] + @pad_size[0], @out_size[1] + @pad_size[1], @num_filters]
-        y = Functions::Col2im.new(img_shape, x_shape[1..2], @filter_size, @strides).(col)
+        img_shape = [bsize, *@out_size, @num_filters]
+        y = Functions::Col2im.new(img_shape, x_shape[1..2], @filter_size, @strides, @padding ? @pad_size : nil).(col)
         y += @bias if @bias
-        y = Functions::Cropping2D.new(@pad_size).(y) if @padding
         y
       end
 
@@ -343,8 +294,7 @@ module DNN
       def forward(x)
         batch_size = x.shape[0]
         ch = x.shape[3]
-        x = Functions::ZeroPadding2D.new(@pad_size).(x) if @padding
-        x = Functions::Im2col.new(@out_size, @pool_size, @strides).(x)
+        x = Functions::Im2col.new(@out_size, @pool_size, @strides, @padding ? @pad_size : nil).(x)
         x = x.reshape(batch_size * @out_size.reduce(:*), @pool_size.reduce(:*), ch)
         x = x.max(axis: 1, keepdims: true)
         x.reshape(batch_size, *@out_size, ch)
@@ -355,8 +305,7 @@ module DNN
       def forward(x)
         batch_size = x.shape[0]
         ch = x.shape[3]
-        x = Functions::ZeroPadding2D.new(@pad_size).(x) if @padding
-        x = Functions::Im2col.new(@out_size, @pool_size, @strides).(x)
+        x = Functions::Im2col.new(@out_size, @pool_size, @strides, @padding ? @pad_size : nil).(x)
         x = x.reshape(batch_size * @out_size.reduce(:*), @pool_size.reduce(:*), ch)
         x = x.mean(axis: 1, keepdims: true)
         x.reshape(batch_size, *@out_size, ch)
@@ -427,10 +376,8 @@ module DNN
         x = x.reshape(x_shape[0..2].reduce(:*), 1, num_filters)
         x = fs.broadcast_to(x, [x_shape[0..2].reduce(:*), @unpool_size.reduce(:*), num_filters])
         col = x.reshape(x_shape[0..2].reduce(:*), @unpool_size.reduce(:*) * num_filters)
-        img_shape = [bsize, @out_size[0] + @pad_size[0], @out_size[1] + @pad_size[1], num_filters]
-        y = Functions::Col2im.new(img_shape, x_shape[1..2], @unpool_size, @unpool_size).(col)
-        y = Functions::Cropping2D.new(@pad_size).(y) if @padding
-        y
+        img_shape = [bsize, *@out_size, num_filters]
+        Functions::Col2im.new(img_shape, x_shape[1..2], @unpool_size, @unpool_size, @padding ? @pad_size : nil).(col)
       end
 
       def to_hash
@@ -244,6 +244,7 @@ module DNN
       end
 
       def forward(xs)
+        return forward_native(xs) if DNN.use_native? && xs.data.is_a?(Numo::SFloat)
         fs = Functions::FunctionSpace
         h_array = [] if @return_sequences
         x_array = fs.split(xs, xs.shape[1], axis: 1).map do |x|
@@ -266,6 +267,18 @@ module DNN
         end
       end
 
+      private def forward_native(xs)
+        h = (@stateful && @h) ? @h : Tensor.new(Xumo::SFloat.zeros(xs.shape[0], @num_units))
+        c = (@stateful && @c) ? @c : Tensor.new(Xumo::SFloat.zeros(xs.shape[0], @num_units))
+        lstm = Functions::LSTM.new(return_sequences: @return_sequences)
+        ys = lstm.(*[xs, h, c, @weight, @recurrent_weight, @bias].compact)
+        if @stateful
+          @h = Tensor.new(lstm.h)
+          @c = Tensor.new(lstm.c)
+        end
+        ys
+      end
+
       def reset_state
         @h = Tensor.new(Xumo::SFloat.zeros(*@h.shape)) if @h
         @c = Tensor.new(Xumo::SFloat.zeros(*@c.shape)) if @c
@@ -300,6 +313,7 @@ module DNN
       end
 
       def forward(xs)
+        return forward_native(xs) if DNN.use_native? && xs.data.is_a?(Numo::SFloat)
         fs = Functions::FunctionSpace
         h_array = [] if @return_sequences
         x_array = fs.split(xs, xs.shape[1], axis: 1).map do |x|
@@ -318,6 +332,14 @@ module DNN
         end
       end
 
+      private def forward_native(xs)
+        h = (@stateful && @h) ? @h : Tensor.new(Xumo::SFloat.zeros(xs.shape[0], @num_units))
+        gru = Functions::GRU.new(return_sequences: @return_sequences)
+        ys = gru.(*[xs, h, @weight, @recurrent_weight, @bias].compact)
+        @h = Tensor.new(gru.h) if @stateful
+        ys
+      end
+
       def reset_state
         @h = Tensor.new(Xumo::SFloat.zeros(*@h.shape)) if @h
       end
@@ -30,7 +30,12 @@ module DNN
       @held_flags[index] = true
       return if @held_flags.compact.length < @num_outputs
       return unless requires_grad
-      dys = @node.backward(*@hold_datas)
+      profiler = Profiler.current
+      dys = if profiler&.functions?
+              profiler.measure_function(@node, :backward) { @node.backward(*@hold_datas) }
+            else
+              @node.backward(*@hold_datas)
+            end
       @hold_datas = []
       @held_flags = []
       if dys.is_a?(Array)
@@ -203,7 +203,7 @@ module DNN
         Utils.check_input_data_type("y", y, Xumo::SFloat)
         set_learning_phase(true)
         inputs = Tensor.convert(x)
-        outputs = call(*inputs)
+        outputs = Profiler.phase(:forward) { call(*inputs) }
         losses = optimize(outputs, Tensor.convert(y))
         if losses.is_a?(Array)
           losses.map { |loss| Utils.to_f(loss.data) }
@@ -226,16 +226,16 @@ module DNN
           result = []
           y.each_index do |i|
             loss_weight = @loss_weights ? @loss_weights[i] : nil
-            loss = compute_train_loss(y[i], t[i], @loss_func[i], loss_weight)
+            loss = Profiler.phase(:forward) { compute_train_loss(y[i], t[i], @loss_func[i], loss_weight) }
             result << loss
-            loss.backward(Xumo::SFloat.ones(y[i].data[0...1, false].shape[0], 1))
+            Profiler.phase(:backward) { loss.backward(Xumo::SFloat.ones(y[i].data[0...1, false].shape[0], 1)) }
           end
         else
-          loss = compute_train_loss(y, t, @loss_func)
+          loss = Profiler.phase(:forward) { compute_train_loss(y, t, @loss_func) }
           result = loss
-          loss.backward(Xumo::SFloat.ones(y.data[0...1, false].shape[0], 1))
+          Profiler.phase(:backward) { loss.backward(Xumo::SFloat.ones(y.data[0...1, false].shape[0], 1)) }
         end
-        @optimizer.update(get_all_trainable_variables)
+        Profiler.phase(:update) { @optimizer.update(get_all_trainable_variables) }
         result
       end
 
@@ -358,6 +358,12 @@ module DNN
         Marshal.load(Marshal.dump(self))
       end
 
+      # Freeze the model for inference.
+      # @return [DNN::FrozenModel] Return the frozen model. See DNN::FrozenModel.
+      def to_frozen_model
+        FrozenModel.new(self)
+      end
+
       # Get the layer that the model has.
       # @param [Symbol] name The name of the layer to get.
       # @return [DNN::Layers::Layer] Return the layer.
@@ -386,6 +392,7 @@ module DNN
       end
 
       # Get parameter data of all layers.
+      # The narrays are not copied, and the native optimizers update them in place. Dup them to keep a snapshot.
       # @return [Array] Parameter data.
       def get_all_params_data
         layers.map do |layer|
@@ -396,11 +403,14 @@ module DNN
       end
 
       # Set parameter data of all layers.
+      # The native optimizers update the data in place, so the narrays are copied by default
+      # in order not to change the narrays of params_data by training.
       # @param [Array] params_data Parameter data obtained by get_all_params_data.
-      def set_all_params_data(params_data)
+      # @param [Boolean] copy Set false to set the narrays without copying, such as when the data of this model is restored.
+      def set_all_params_data(params_data, copy: true)
         layers.each.with_index do |layer, i|
           params_data[i].each do |(key, data)|
-            layer.get_variables[key].data = data
+            layer.get_variables[key].data = copy && data ? data.dup : data
           end
         end
       end
@@ -410,7 +420,7 @@ module DNN
       def to_cpu
         params_data = get_all_params_data
         clean_layers
-        set_all_params_data(params_data)
+        set_all_params_data(params_data, copy: false)
         layers.each do |layer|
           layer.get_variables.each do |key, param|
             data = param.data
@@ -435,7 +445,7 @@ module DNN
       def to_gpu
         params_data = get_all_params_data
         clean_layers
-        set_all_params_data(params_data)
+        set_all_params_data(params_data, copy: false)
         layers.each do |layer|
           layer.get_variables.each do |(key, param)|
             data = param.data
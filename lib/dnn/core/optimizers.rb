@@ -20,9 +20,19 @@ module DNN
         @clip_norm = clip_norm
       end
 
+      # Update the variables by the gradients.
+      # When the native kernels are used, param.data is updated in place instead of being replaced by a new narray.
+      # So an narray obtained from param.data before the update, for example by Model#get_all_params_data,
+      # is changed by the update. Dup it to keep the values. Model#set_all_params_data copies the narrays by default.
+      # @param [Array] variables Variables to update.
       def update(variables)
-        clip_grads(variables) if @clip_norm
-        update_variables(variables)
+        if update_native?(variables)
+          clip_rate = @clip_norm ? clip_rate_native(variables) : 1
+          update_variables_native(variables, clip_rate)
+        else
+          clip_grads(variables) if @clip_norm
+          update_variables(variables)
+        end
         variables.each do |param|
           param.grad = Xumo::SFloat[0]
         end
@@ -48,6 +58,24 @@ module DNN
         end
       end
 
+      # Return true if the variables can be updated by the fused kernels of rb_dnn_native.
+      # The kernels update the data and the status in place. A non-contiguous grad such as a transposed view
+      # is updated by the ruby implementation.
+      private def update_native?(variables)
+        return false unless DNN.use_native? && respond_to?(:update_variables_native, true) && Native.respond_to?(:sum_squares)
+        variables.all? do |param|
+          param.data.is_a?(Xumo::SFloat) && param.data.contiguous? &&
+            param.grad.is_a?(Xumo::SFloat) && param.grad.contiguous? &&
+            (param.grad.size == param.data.size || param.grad.size == 1)
+        end
+      end
+
+      # Compute the gradient clip rate without allocating the squared gradients.
+      private def clip_rate_native(variables)
+        norm = Math.sqrt(Native.sum_squares(variables.map(&:grad)))
+        norm <= @clip_norm ? 1 : @clip_norm / (norm + 1e-7)
+      end
+
       def load_hash(hash)
         initialize(clip_norm: hash[:clip_norm])
       end
@@ -83,6 +111,11 @@ module DNN
         end
       end
 
+      private def update_variables_native(variables, clip_rate)
+        vs = variables.map { |param| @v[param] ||= Xumo::SFloat.zeros(*param.data.shape) } if @momentum > 0
+        Native.sgd_update(variables.map(&:data), variables.map(&:grad), vs, @lr, @momentum, clip_rate)
+      end
+
       def load_hash(hash)
         initialize(lr: hash[:lr], momentum: hash[:momentum], clip_norm: hash[:clip_norm])
       end
@@ -101,6 +134,11 @@ module DNN
           param.data = (param.data + @momentum**2 * @v[param]) - (1 + @momentum) * amount
         end
       end
+
+      private def update_variables_native(variables, clip_rate)
+        vs = variables.map { |param| @v[param] ||= Xumo::SFloat.zeros(*param.data.shape) }
+        Native.nesterov_update(variables.map(&:data), variables.map(&:grad), vs, @lr, @momentum, clip_rate)
+      end
     end
 
     class AdaGrad < Optimizer
@@ -125,6 +163,11 @@ module DNN
         end
       end
 
+      private def update_variables_native(variables, clip_rate)
+        gs = variables.map { |param| @g[param] ||= Xumo::SFloat.zeros(*param.data.shape) }
+        Native.adagrad_update(variables.map(&:data), variables.map(&:grad), gs, @lr, @eps, clip_rate)
+      end
+
       def to_hash
         super(lr: @lr, eps: @eps)
       end
@@ -163,6 +206,11 @@ module DNN
         end
       end
 
+      private def update_variables_native(variables, clip_rate)
+        gs = variables.map { |param| @g[param] ||= Xumo::SFloat.zeros(*param.data.shape) }
+        Native.rmsprop_update(variables.map(&:data), variables.map(&:grad), gs, @lr, @alpha, @eps, clip_rate)
+      end
+
       def load_hash(hash)
         initialize(lr: hash[:lr], alpha: hash[:alpha], eps: hash[:eps], clip_norm: hash[:clip_norm])
       end
@@ -291,6 +339,15 @@ module DNN
         end
       end
 
+      private def update_variables_native(variables, clip_rate)
+        @t += 1
+        lr = @alpha * Math.sqrt(1 - @beta2**@t) / (1 - @beta1**@t)
+        ms = variables.map { |param| @m[param] ||= Xumo::SFloat.zeros(*param.data.shape) }
+        vs = variables.map { |param| @v[param] ||= Xumo::SFloat.zeros(*param.data.shape) }
+        ss = variables.map { |param| @s[param] ||= Xumo::SFloat.zeros(*param.data.shape) } if @amsgrad
+        Native.adam_update(variables.map(&:data), variables.map(&:grad), ms, vs, ss, lr, @beta1, @beta2, @eps, clip_rate)
+      end
+
       def load_hash(hash)
         initialize(alpha: hash[:alpha], beta1: hash[:beta1], beta2: hash[:beta2],
                    eps: hash[:eps], amsgrad: hash[:amsgrad], clip_norm: hash[:clip_norm])
@@ -337,6 +394,11 @@ module DNN
         end
       end
 
+      # The learning rate of AdaBound is clipped for each element, so the Adam kernel is not used.
+      private def update_native?(variables)
+        false
+      end
+
       private def clip_lr(lr, lower_bound, upper_bound)
         lr[lr < lower_bound] = lower_bound
         lr[lr > upper_bound] = upper_bound
@@ -0,0 +1,225 @@
+module DNN
+  # This module reads and writes the packed tensor format.
+  # A packed tensor file is a header followed by the raw little-endian data in row-major order.
+  # The data is swapped from and to the host byte order on big-endian hosts.
+  # The header holds the magic, dtype name, layout name, ndim, data offset and shape, and the data
+  # starts at a 64 byte aligned offset so that the file can be memory mapped.
+  module PackedTensor
+    class PackedTensorError < DNNError; end
+
+    MAGIC = "RBDNNPT\x01".b
+    ALIGNMENT = 64
+    DTYPES = %w[SFloat DFloat Int8 Int16 Int32 Int64 UInt8 UInt16 UInt32 UInt64].freeze
+    HOST_BIG_ENDIAN = [1].pack("S") == [1].pack("S>")
+    # The elements are swapped as unsigned integers of the same size so that the bits are kept.
+    SWAP_DIRECTIVES = { 2 => %w[S> S<], 4 => %w[L> L<], 8 => %w[Q> Q<] }.freeze
+
+    # Write a narray to a packed tensor file.
+    # @param [String] file_name File name to write.
+    # @param [Xumo::NArray] narray Data to write. The first axis is treated as the sample axis.
+    # @param [String | NilClass] layout Layout name of the data such as "NHWC".
+    def self.write(file_name, narray, layout: nil)
+      Writer.open(file_name, narray.class, narray.shape[1..-1], layout: layout) do |writer|
+        writer.write(narray)
+      end
+    end
+
+    # Read the whole packed tensor file.
+    # @param [String] file_name File name to read.
+    # @return [Xumo::NArray] Return the data.
+    def self.read(file_name)
+      reader = Reader.new(file_name, random: false)
+      reader.read_all
+    ensure
+      reader&.close
+    end
+
+    # Convert the binary between the host byte order and little-endian.
+    # The conversion is the same in both directions, and the binary is returned as is on little-endian hosts.
+    # @param [String] bin Binary of the elements.
+    # @param [Integer] element_size Byte size of one element.
+    # @param [Boolean] big_endian Set true if the host is big-endian.
+    # @return [String] Return the converted binary.
+    def self.convert_byte_order(bin, element_size, big_endian: HOST_BIG_ENDIAN)
+      return bin unless big_endian && SWAP_DIRECTIVES[element_size]
+      big, little = SWAP_DIRECTIVES[element_size]
+      bin.unpack("#{big}*").pack("#{little}*")
+    end
+
+    # @param [Class] narray_class Class of data.
+    # @return [String] Return the dtype name.
+    def self.dtype_name(narray_class)
+      name = narray_class.name.split("::").last
+      raise PackedTensorError, "#{narray_class} is not supported." unless DTYPES.include?(name)
+      name
+    end
+
+    # Write samples to a packed tensor file in several chunks.
+    # Use this to pack datasets that do not fit in memory.
+    class Writer
+      # @param [String] file_name File name to write.
+      # @param [Class] narray_class Class of data.
+      # @param [Array] sample_shape Shape of one sample.
+      # @param [String | NilClass] layout Layout name of the data such as "NHWC".
+      # @yield [DNN::PackedTensor::Writer] The writer is closed after the block.
+      def self.open(file_name, narray_class, sample_shape, layout: nil)
+        writer = new(file_name, narray_class, sample_shape, layout: layout)
+        return writer unless block_given?
+        begin
+          yield writer
+        ensure
+          writer.close
+        end
+      end
+
+      attr_reader :num_samples
+
+      def initialize(file_name, narray_class, sample_shape, layout: nil)
+        @dtype = PackedTensor.dtype_name(narray_class)
+        @sample_shape = sample_shape
+        @layout = layout.to_s
+        raise PackedTensorError, "layout is too long." if @layout.bytesize > 16
+        @num_samples = 0
+        @file = File.open(file_name, "wb")
+        @data_offset = header_size
+        @file.write("\0" * @data_offset)
+      end
+
+      # Append samples to the file.
+      # @param [Xumo::NArray] narray Samples in the form [num_samples, *sample_shape].
+      def write(narray)
+        unless narray.shape[1..-1] == @sample_shape
+          raise DNNShapeError, "The shape of samples is #{narray.shape[1..-1]}, but expected #{@sample_shape}."
+        end
+        unless PackedTensor.dtype_name(narray.class) == @dtype
+          raise PackedTensorError, "The dtype of samples is #{narray.class}, but expected #{@dtype}."
+        end
+        @file.write(PackedTensor.convert_byte_order(narray.to_binary, narray.class::ELEMENT_BYTE_SIZE))
+        @num_samples += narray.shape[0]
+        self
+      end
+
+      alias << write
+
+      # Write the header and close the file.
+      def close
+        return if @file.closed?
+        @file.seek(0)
+        @file.write(header)
+        @file.close
+      end
+
+      private def header_size
+        size = MAGIC.bytesize + 16 + 16 + 4 + 4 + 8 * (@sample_shape.length + 1)
+        (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT
+      end
+
+      private def header
+        shape = [@num_samples, *@sample_shape]
+        [MAGIC, @dtype, @layout, shape.length, @data_offset, *shape].pack("a8a16a16VVQ<*")
+      end
+    end
+
+    # Read samples from a packed tensor file.
+    # The file is memory mapped with rb_dnn_native if it is available, so opening is instant
+    # and only the gathered pages are read.
+    class Reader
+      attr_reader :shape
+      attr_reader :layout
+      attr_reader :narray_class
+
+      # @param [String] file_name File name to read.
+      # @param [Boolean] random Set true if samples are read in random order.
+      def initialize(file_name, random: true)
+        @file_name = file_name
+        if defined?(Native::MappedFile)
+          @mapped_file = Native::MappedFile.new(file_name, random)
+        else
+          @file = File.open(file_name, "rb")
+        end
+        read_header
+        @buffer = "".b
+        # The samples can be copied into the narray without converting the byte order only on little-endian hosts.
+        @gather_narray = @mapped_file && Native::MappedFile::GATHER_NARRAY && !HOST_BIG_ENDIAN && !DNN.use_cumo?
+      end
+
+      # @return [Integer] Return the number of samples.
+      def num_samples
+        @shape[0]
+      end
+
+      # Gather samples into one batch.
+      # When the file is memory mapped on a little-endian host, the samples are copied straight from the mapped pages
+      # into the narray. Otherwise they are read into a reused buffer and then copied into the narray.
+      # @param [Array] indexes Indexes of the samples to gather.
+      # @param [Xumo::NArray | NilClass] out Contiguous narray in the form [indexes.length, *sample_shape] to gather into.
+      #                                      Pass the same narray every batch to reuse it. If nil, a new narray is created.
+      # @return [Xumo::NArray] Return the batch in the form [indexes.length, *sample_shape].
+      def gather(indexes, out: nil)
+        shape = [indexes.length, *@shape[1..-1]]
+        if out && !(out.is_a?(@narray_class) && out.shape == shape)
+          raise DNNShapeError, "out must be #{@narray_class} of the shape #{shape}, but #{out.class} of the shape #{out.shape}."
+        end
+        if @gather_narray
+          out ||= @narray_class.new(*shape)
+          @mapped_file.gather(@data_offset, @sample_bytes, indexes, out)
+          return out
+        end
+        if @mapped_file
+          @mapped_file.gather(@data_offset, @sample_bytes, indexes, @buffer)
+        else
+          @buffer.clear
+          indexes.each do |index|
+            raise IndexError, "index #{index} is out of range (0...#{num_samples})." unless index.between?(0, num_samples - 1)
+            @buffer << read_bytes(@data_offset + index * @sample_bytes, @sample_bytes)
+          end
+        end
+        bin = PackedTensor.convert_byte_order(@buffer, @narray_class::ELEMENT_BYTE_SIZE)
+        batch = @narray_class.from_binary(bin, shape)
+        return batch unless out
+        out[false] = batch
+        out
+      end
+
+      # @return [Xumo::NArray] Return all samples.
+      def read_all
+        bin = read_bytes(@data_offset, num_samples * @sample_bytes)
+        @narray_class.from_binary(PackedTensor.convert_byte_order(bin, @narray_class::ELEMENT_BYTE_SIZE), @shape)
+      end
+
+      def close
+        @mapped_file&.close
+        @file&.close
+      end
+
+      private def file_size
+        @mapped_file ? @mapped_file.size : @file.size
+      end
+
+      private def read_bytes(offset, length)
+        raise PackedTensorError, "#{@file_name} is truncated." if offset + length > file_size
+        if @mapped_file
+          @mapped_file.read(offset, length)
+        else
+          @file.seek(offset)
+          bin = @file.read(length) || "".b
+          raise PackedTensorError, "#{@file_name} is truncated." if bin.bytesize < length
+          bin
+        end
+      end
+
+      private def read_header
+        magic, dtype, layout, ndim, @data_offset = read_bytes(0, 48).unpack("a8Z16Z16VV")
+        raise PackedTensorError, "#{@file_name} is not a packed tensor file." unless magic == MAGIC
+        raise PackedTensorError, "dtype #{dtype} is not supported." unless DTYPES.include?(dtype)
+        @shape = read_bytes(48, 8 * ndim).unpack("Q<*")
+        @layout = layout.empty? ? nil : layout
+        @narray_class = Xumo.const_get(dtype)
+        @sample_bytes = @shape[1..-1].reduce(1, :*) * @narray_class::ELEMENT_BYTE_SIZE
+        if @data_offset + num_samples * @sample_bytes > file_size
+          raise PackedTensorError, "#{@file_name} is truncated."
+        end
+      end
+    end
+  end
+end
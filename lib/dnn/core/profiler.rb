@@ -0,0 +1,158 @@
+module DNN
+  # This class measures the forward and backward of each function and the phases of the training step.
+  # Profiling is enabled on the thread that started the profiler until it is stopped.
+  # Allocations are the number of Ruby objects allocated by the process, and bytes is the size of
+  # the narrays returned by the function.
+  # When Cumo is used, the kernels run asynchronously, so the measured time is not exact.
+  class Profiler
+    THREAD_KEY = :dnn_profiler
+
+    # The phases of the training step.
+    # data:      Fetch the batch from the iterator.
+    # forward:   Forward propagation and the loss.
+    # backward:  Backward propagation.
+    # update:    Update the parameters by the optimizer.
+    PHASES = [:data, :forward, :backward, :update].freeze
+
+    class Stat
+      attr_reader :calls
+      attr_reader :time
+      attr_reader :allocations
+      attr_reader :bytes
+
+      def initialize
+        @calls = 0
+        @time = 0.0
+        @allocations = 0
+        @bytes = 0
+      end
+
+      def add(time, allocations, bytes)
+        @calls += 1
+        @time += time
+        @allocations += allocations
+        @bytes += bytes
+      end
+
+      def to_h
+        { calls: @calls, time: @time, allocations: @allocations, bytes: @bytes }
+      end
+    end
+
+    # @return [DNN::Profiler | NilClass] Return the profiler started on this thread.
+    def self.current
+      Thread.current[THREAD_KEY]
+    end
+
+    # Measure a phase of the training step if a profiler is started on this thread.
+    # @param [Symbol] name Phase name. See DNN::Profiler::PHASES.
+    def self.phase(name)
+      profiler = current
+      return yield unless profiler
+      profiler.measure_phase(name) { yield }
+    end
+
+    attr_reader :function_stats
+    attr_reader :phase_times
+
+    # @param [Boolean] functions Set true to measure the forward and backward of each function.
+    def initialize(functions: true)
+      @functions = functions
+      reset
+    end
+
+    # @return [Boolean] Return true if the forward and backward of each function are measured.
+    def functions?
+      @functions
+    end
+
+    # Start profiling on this thread.
+    def start
+      Thread.current[THREAD_KEY] = self
+      self
+    end
+
+    # Stop profiling on this thread.
+    def stop
+      Thread.current[THREAD_KEY] = nil if Profiler.current.equal?(self)
+      self
+    end
+
+    # Profile the block.
+    def profile
+      start
+      yield
+    ensure
+      stop
+    end
+
+    # Clear the measured results.
+    def reset
+      @function_stats = Hash.new { |h, k| h[k] = { forward: Stat.new, backward: Stat.new } }
+      @phase_times = Hash.new(0.0)
+      @step_phase_times = Hash.new(0.0)
+    end
+
+    # @param [DNN::Functions::Function] node Function to measure.
+    # @param [Symbol] direction :forward or :backward.
+    def measure_function(node, direction)
+      allocations = GC.stat(:total_allocated_objects)
+      start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      result = yield
+      time = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+      allocations = GC.stat(:total_allocated_objects) - allocations
+      @function_stats[node.class.name][direction].add(time, allocations, byte_size(result))
+      result
+    end
+
+    # @param [Symbol] name Phase name.
+    def measure_phase(name)
+      start_time = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      yield
+    ensure
+      time = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start_time
+      @phase_times[name] += time
+      @step_phase_times[name] += time
+    end
+
+    # Return the phase times measured since the last call.
+    # @return [Hash] Return the time of each phase in seconds.
+    def take_step_phase_times
+      times = PHASES.to_h { |phase| [phase, @step_phase_times[phase]] }
+      @step_phase_times = Hash.new(0.0)
+      times
+    end
+
+    # @return [Hash] Return the results in the form { phases: { phase => time }, functions: { name => { forward:, backward: } } }.
+    def to_h
+      functions = @function_stats.to_h do |name, stats|
+        [name, { forward: stats[:forward].to_h, backward: stats[:backward].to_h }]
+      end
+      { phases: PHASES.to_h { |phase| [phase, @phase_times[phase]] }, functions: functions }
+    end
+
+    # @param [Integer] limit Number of functions to show.
+    # @return [String] Return the summary of the functions sorted by the total time.
+    def summary(limit: 20)
+      lines = [format("%-40s %10s %12s %12s %14s", "function", "calls", "forward[s]", "backward[s]", "allocations")]
+      stats = @function_stats.sort_by { |_, s| -(s[:forward].time + s[:backward].time) }
+      stats.first(limit).each do |name, s|
+        allocations = s[:forward].allocations + s[:backward].allocations
+        lines << format("%-40s %10d %12.4f %12.4f %14d", name, s[:forward].calls, s[:forward].time, s[:backward].time, allocations)
+      end
+      phases = PHASES.map { |phase| format("%s: %.4f", phase, @phase_times[phase]) }
+      lines << "phases[s] #{phases.join(", ")}"
+      lines.join("\n")
+    end
+
+    private def byte_size(result)
+      if result.is_a?(Array)
+        result.sum { |v| byte_size(v) }
+      elsif result.is_a?(Xumo::NArray)
+        result.byte_size
+      else
+        0
+      end
+    end
+  end
+end
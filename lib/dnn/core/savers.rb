@@ -1,6 +1,8 @@
 require "zlib"
 require "json"
 require "base64"
+require "stringio"
+require "tempfile"
 
 module DNN
   module Loaders
@@ -31,7 +33,7 @@ module DNN
             @model.instance_variable_set(ivar, obj)
           end
         end
-        @model.set_all_params_data(data[:params])
+        @model.set_all_params_data(data[:params], copy: false)
       end
     end
 
@@ -55,6 +57,144 @@ module DNN
       end
     end
 
+    # This class loads the params saved by DNN::Savers::BinarySaver.
+    # Only the index is read when the file is opened, and each tensor is read from the
+    # memory mapped file when it is set to the layer, so the whole file is never held in memory.
+    class BinaryLoader < Loader
+      # This class reads the tensors of a binary checkpoint on demand.
+      class Reader
+        attr_reader :class_name
+        attr_reader :version
+        # @return [Array] Index entries of the tensors. Each entry is a Hash of layer, key, dtype, shape, offset, size and crc32.
+        attr_reader :entries
+
+        # @param [String] file_name File name to read.
+        def initialize(file_name)
+          @file_name = file_name
+          if defined?(Native::MappedFile)
+            @mapped_file = Native::MappedFile.new(file_name, true)
+          else
+            @file = File.open(file_name, "rb")
+          end
+          # The tensor can be copied from the mapped pages into the narray only on little-endian hosts.
+          @gather_narray = @mapped_file && Native::MappedFile::GATHER_NARRAY && !PackedTensor::HOST_BIG_ENDIAN && !DNN.use_cumo?
+          read_index
+        end
+
+        # @param [Integer] layer Index of the layer in model.layers.
+        # @param [Symbol] key Name of the variable.
+        # @return [Hash | NilClass] Return the index entry of the tensor.
+        def entry(layer, key)
+          @entries.find { |entry| entry[:layer] == layer && entry[:key] == key }
+        end
+
+        # Read a tensor.
+        # The checksum is computed from the bytes read into a string, so verify copies the tensor twice.
+        # Without verify, the tensor is copied once from the mapped pages into the narray if the file is mapped.
+        # @param [Hash] entry Index entry of the tensor.
+        # @param [Boolean] verify Set true to verify the checksum.
+        # @return [Xumo::NArray] Return the tensor.
+        def read(entry, verify: true)
+          narray_class = Xumo.const_get(entry[:dtype])
+          if !verify && @gather_narray && entry[:size] > 0 && !entry[:shape].empty?
+            narray = narray_class.new(*entry[:shape])
+            @mapped_file.gather(entry[:offset], entry[:size], [0], narray)
+            return narray
+          end
+          bin = read_bytes(entry[:offset], entry[:size])
+          if verify && Zlib.crc32(bin) != entry[:crc32]
+            raise DNNError, "Checksum of layer #{entry[:layer]} #{entry[:key]} is mismatch."
+          end
+          narray_class.from_binary(PackedTensor.convert_byte_order(bin, narray_class::ELEMENT_BYTE_SIZE), entry[:shape])
+        end
+
+        def close
+          @mapped_file&.close
+          @file&.close
+        end
+
+        private def read_bytes(offset, length)
+          if @mapped_file
+            raise DNNError, "#{@file_name} is truncated." if offset + length > @mapped_file.size
+            @mapped_file.read(offset, length)
+          else
+            @file.seek(offset)
+            bin = @file.read(length) || "".b
+            raise DNNError, "#{@file_name} is truncated." if bin.bytesize < length
+            bin
+          end
+        end
+
+        private def read_index
+          magic, index_offset, index_size = read_bytes(0, Savers::BinarySaver::HEADER_SIZE).unpack("a8Q<Q<")
+          raise DNNError, "#{@file_name} is not a binary checkpoint." unless magic == Savers::BinarySaver::MAGIC
+          index = JSON.parse(read_bytes(index_offset, index_size), symbolize_names: true)
+          @version = index[:version]
+          @class_name = index[:class]
+          @entries = index[:tensors].map do |entry|
+            entry.merge(key: entry[:key].to_sym)
+          end
+        end
+      end
+
+      # @param [DNN::Models::Model] model Model to set the params.
+      # @param [Array | NilClass] layers Layers or indexes of model.layers to load. If nil, all layers are loaded.
+      # @param [Boolean] verify Set true to verify the checksum of each tensor.
+      def initialize(model, layers: nil, verify: true)
+        super(model)
+        @layers = layers
+        @verify = verify
+      end
+
+      def load(file_name)
+        reader = Reader.new(file_name)
+        load_from_reader(reader)
+      ensure
+        reader&.close
+      end
+
+      def load_bin(bin)
+        Tempfile.create("rb_dnn_checkpoint") do |file|
+          file.binmode
+          file.write(bin)
+          file.flush
+          load(file.path)
+        end
+      end
+
+      private def load_from_reader(reader)
+        unless @model.class.name == reader.class_name
+          raise DNNError, "Class name is mismatch. Target model is #{@model.class.name}. But loading model is #{reader.class_name}."
+        end
+        model_layers = @model.layers
+        target_indexes = if @layers
+                           @layers.map do |layer|
+                             index = layer.is_a?(Integer) ? layer : model_layers.index(layer)
+                             raise DNNError, "Layer #{layer.inspect} is not found in the model." unless index && model_layers[index]
+                             index
+                           end
+                         else
+                           model_layers.length.times.to_a
+                         end
+        loaded_keys = Hash.new { |h, k| h[k] = [] }
+        reader.entries.each do |entry|
+          next unless target_indexes.include?(entry[:layer])
+          param = model_layers[entry[:layer]].get_variables[entry[:key]]
+          raise DNNError, "Variable #{entry[:key]} of layer #{entry[:layer]} is not found." unless param.is_a?(Variable)
+          param.data = reader.read(entry, verify: @verify)
+          loaded_keys[entry[:layer]] << entry[:key]
+        end
+        # The recurrent states such as h of RNN are not variables, so they are not required.
+        # A variable without data is required, since the checkpoint of the built model has it.
+        target_indexes.each do |index|
+          required_keys = model_layers[index].get_variables.select { |_, param| param.is_a?(Variable) }.keys
+          missing_keys = required_keys - loaded_keys[index]
+          next if missing_keys.empty?
+          raise DNNError, "Variables #{missing_keys.join(", ")} of layer #{index} (#{model_layers[index].class.name}) are not found in the checkpoint."
+        end
+      end
+    end
+
   end
 
   module Savers
@@ -98,7 +238,7 @@ module DNN
           data = { version: VERSION, class: @model.class.name, params: params_data }
         end
         bin = Zlib::Deflate.deflate(Marshal.dump(data))
-        @model.set_all_params_data(params_data) if @include_model
+        @model.set_all_params_data(params_data, copy: false) if @include_model
         bin
       end
     end
@@ -119,5 +259,51 @@ module DNN
       end
     end
 
+    # This class saves the params in a binary checkpoint.
+    # The file is a header, the raw little-endian tensors and a JSON index with the offset, shape and CRC32 of each tensor.
+    # Tensors are written to the file one by one, so the whole model is never serialized in memory.
+    class BinarySaver < Saver
+      MAGIC = "RBDNNCK\x01".b
+      HEADER_SIZE = 24
+      ALIGNMENT = 64
+
+      def save(file_name)
+        dir_name = File.dirname(file_name)
+        Dir.mkdir(dir_name) unless Dir.exist?(dir_name)
+        File.open(file_name, "wb") do |file|
+          write(file)
+        end
+      end
+
+      def dump_bin
+        io = StringIO.new("".b)
+        write(io)
+        io.string
+      end
+
+      private def write(io)
+        io.write("\0" * ALIGNMENT)
+        tensors = []
+        @model.layers.each.with_index do |layer, i|
+          layer.get_variables.each do |key, param|
+            # nil is the variable of an unused option such as use_bias: false, and a Tensor is a recurrent state.
+            next unless param.is_a?(Variable) && param.data
+            bin = PackedTensor.convert_byte_order(param.data.to_binary, param.data.class::ELEMENT_BYTE_SIZE)
+            tensors << {
+              layer: i, key: key, dtype: param.data.class.name.split("::").last, shape: param.data.shape,
+              offset: io.pos, size: bin.bytesize, crc32: Zlib.crc32(bin),
+            }
+            io.write(bin)
+            io.write("\0" * (-io.pos % ALIGNMENT))
+          end
+        end
+        index = JSON.dump(version: VERSION, class: @model.class.name, tensors: tensors)
+        index_offset = io.pos
+        io.write(index)
+        io.seek(0)
+        io.write([MAGIC, index_offset, index.bytesize].pack("a8Q<Q<"))
+      end
+    end
+
   end
 end
@@ -27,6 +27,9 @@ module DNN
                 need_accuracy: need_accuracy,
                 io: io)
       update while training?
+    rescue Exception => e
+      trainer_train_error(e)
+      raise
     end
 
     # Start training by iterator.
@@ -55,6 +58,9 @@ module DNN
                             need_accuracy: need_accuracy,
                             io: io)
       update while training?
+    rescue Exception => e
+      trainer_train_error(e)
+      raise
     end
 
     # Start training.
@@ -157,7 +163,7 @@ module DNN
       model.set_learning_phase(true)
       x = Tensor.convert(x_batch)
       y = Tensor.convert(y_batch)
-      outputs = model.(*x)
+      outputs = Profiler.phase(:forward) { model.(*x) }
       losses = model.optimize(outputs, y)
       if losses.is_a?(Array)
         loss_value = []
@@ -234,7 +240,7 @@ module DNN
     # @param [Boolean] need_accuracy Set true to compute the accuracy.
     # @return [Hash] Hash of contents to be output to log.
     def train_step
-      batches = @train_iterator.next_batch(@train_batch_size)
+      batches = Profiler.phase(:data) { @train_iterator.next_batch(@train_batch_size) }
       call_callbacks(:before_train_on_batch)
       train_step_met = on_train_step(*batches)
       @last_logs.merge!(train_step_met)
@@ -281,7 +287,7 @@ module DNN
           @train_iterator.reset
           @train_state = :start_train_epoch
         else
-          @train_state = :none
+          @train_state = :trainer_end_training
         end
       end
     end
@@ -326,6 +332,12 @@ module DNN
       end
     end
 
+    # Stop the training and call on_train_error so that the callbacks can release what they set up in before_train.
+    def trainer_train_error(error)
+      @train_state = :none
+      call_callbacks(:on_train_error, error)
+    end
+
     def trainer_end_training
       call_callbacks(:after_train)
       @train_state = :none
@@ -48,5 +48,37 @@ module DNN
       y_test = datas[true, 0]
       [x_test, y_test]
     end
+
+    # Pack the training data into packed tensor files for DNN::MmapIterator.
+    # Each batch file is converted on its own, so the whole dataset is never held in memory.
+    # @param [String] x_file_name File name to write images.
+    # @param [String] y_file_name File name to write labels.
+    def self.pack_train(x_file_name, y_file_name)
+      downloads
+      fnames = (1..5).map { |i| DOWNLOADS_PATH + "/downloads/#{DIR_CIFAR10}/data_batch_#{i}.bin" }
+      pack(fnames, x_file_name, y_file_name)
+    end
+
+    # Pack the test data into packed tensor files for DNN::MmapIterator.
+    # @param [String] x_file_name File name to write images.
+    # @param [String] y_file_name File name to write labels.
+    def self.pack_test(x_file_name, y_file_name)
+      downloads
+      pack([DOWNLOADS_PATH + "/downloads/#{DIR_CIFAR10}/test_batch.bin"], x_file_name, y_file_name)
+    end
+
+    private_class_method def self.pack(fnames, x_file_name, y_file_name)
+      x_writer = PackedTensor::Writer.new(x_file_name, Numo::UInt8, [32, 32, 3], layout: "NHWC")
+      y_writer = PackedTensor::Writer.new(y_file_name, Numo::UInt8, [])
+      fnames.each do |fname|
+        raise DNN_CIFAR10_LoadError, %`file "#{fname}" is not found.` unless File.exist?(fname)
+        datas = Numo::UInt8.from_binary(File.binread(fname)).reshape(10000, 3073)
+        x_writer << datas[true, 1...3073].reshape(10000, 3, 32, 32).transpose(0, 2, 3, 1)
+        y_writer << datas[true, 0]
+      end
+    ensure
+      x_writer&.close
+      y_writer&.close
+    end
   end
 end
@@ -1,3 +1,4 @@
+require "etc"
 require "numo/narray"
 require_relative "../rb_stb_image"
 
@@ -25,6 +26,26 @@ module DNN
       img.reshape(h, w, channel_type)
     end
 
+    # Read images from files and resize them into one batch.
+    # Decoding and resizing run on native threads without holding the GVL.
+    # An image that already has the size is copied without resizing.
+    # @param [Array] file_names File names to read.
+    # @param [Integer] height Image height to resize.
+    # @param [Integer] width Image width to resize.
+    # @param [Integer] channel_type Specify channel type of image.
+    # @param [Integer] threads Number of threads to use for decoding.
+    # @return [Numo::UInt8] Return the images in the form [file_names.length, height, width, channel_type].
+    def self.read_batch(file_names, height, width, channel_type = RGB, threads: Etc.nprocessors)
+      file_names.each do |file_name|
+        raise ImageReadError, "#{file_name} is not found." unless File.exist?(file_name)
+      end
+      bin, failed_indexes = Stb.load_batch(file_names, height, width, channel_type, threads)
+      unless failed_indexes.empty?
+        raise ImageReadError, "#{failed_indexes.map { |i| file_names[i] }.join(", ")} load failed."
+      end
+      Numo::UInt8.from_binary(bin).reshape(file_names.length, height, width, channel_type)
+    end
+
     # Write image to file.
     # @param [String] file_name File name to write.
     # @param [Numo::UInt8] img Image to write.
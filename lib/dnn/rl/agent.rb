@@ -13,16 +13,19 @@ module DNN
       # @param [Integer] batch_size Batch size used for one training.
       # @param [Float] gamma Discount rate of reward.
       # @param [RL::Policies::Policy] policy The policy to use for training.
+      # @param [RL::Memory | NilClass] memory Memory for storing the transitions such as RL::PrioritizedMemory.
+      #                                       Setting nil creates RL::Memory from max_memory_size and train_memory_size.
       def initialize(model, env,
                     max_memory_size: 1024,
                     train_memory_size: nil,
                     batch_size: 64,
                     gamma: 0.99,
-                    policy: Policies::EpsGreedy.new)
+                    policy: Policies::EpsGreedy.new,
+                    memory: nil)
         super()
         @model = model
         @env = env
-        @memory = Memory.new(max_memory_size, train_memory_size || batch_size)
+        @memory = memory || Memory.new(max_memory_size, train_memory_size || batch_size)
         @batch_size = batch_size
         @gamma = gamma
         @target_model = nil
@@ -33,8 +36,12 @@ module DNN
         raise NotImplementedError, "Class '#{self.class.name}' has implement method 'replay'"
       end
 
-      def compute_q_value(reward, next_state)
-        raise NotImplementedError, "Class '#{self.class.name}' has implement method 'compute_q_value'"
+      # @param [Numo::SFloat] rewards Rewards of the minibatch.
+      # @param [Numo::SFloat] next_states Next states of the minibatch.
+      # @param [Numo::SFloat] dones 1 when the episode is ended.
+      # @return [Numo::SFloat] Return the target Q values of the taken actions.
+      def compute_q_values(rewards, next_states, dones)
+        raise NotImplementedError, "Class '#{self.class.name}' has implement method 'compute_q_values'"
       end
 
       # def pre_epispde; end
@@ -54,7 +61,7 @@ module DNN
               action = get_action(observation, episode)
               next_observation, reward, done = *@env.step(action)
               next_observation = nil if done
-              @memory.add([observation, action, reward, next_observation])
+              @memory.add(observation, action, reward, next_observation, done)
               observation = next_observation unless done
             end
             if done
@@ -102,17 +109,18 @@ module DNN
         call_callbacks(:after_run)
       end
 
-      def make_batch(memory_batch)
-        x = Numo::SFloat.zeros(@batch_size, @env.state_size)
-        y = Numo::SFloat.zeros(@batch_size, @env.action_size)
-        memory_batch.each.with_index do |(state, action, reward, next_state), i|
-          x[i, false] = state
-          q_value = compute_q_value(@model, @target_model, reward, next_state)
-          q_values = @model.predict1(state)
-          q_values[action] = q_value
-          y[i, false] = q_values
-        end
-        [x, y]
+      # Make the training data from the minibatch sampled from the memory.
+      # When the minibatch has the importance sampling weights, the TD errors in y are scaled by the weights
+      # so that the gradient of the squared error is weighted.
+      # @param [RL::Memory::Batch] batch Minibatch sampled from the memory.
+      # @return [Array] Return [x, y, td_errors].
+      def make_batch(batch)
+        y = @model.predict(batch.states)
+        index = Xumo::Int32.new(batch.size).seq * @env.action_size + batch.actions
+        q_values = y[index]
+        td_errors = compute_q_values(batch.rewards, batch.next_states, batch.dones) - q_values
+        y[index] = batch.weights ? q_values + td_errors * batch.weights : q_values + td_errors
+        [batch.states, y, td_errors]
       end
 
       def get_action(observation, episode)
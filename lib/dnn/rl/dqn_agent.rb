@@ -7,9 +7,12 @@ module DNN
                     batch_size: 64,
                     gamma: 0.99,
                     policy: Policies::EpsGreedy.new,
+                    memory: nil,
+                    replay_steps: nil,
                     ddqn: true)
         super(model, env, max_memory_size: max_memory_size, train_memory_size: train_memory_size, batch_size: batch_size,
-              gamma: gamma, policy: policy)
+              gamma: gamma, policy: policy, memory: memory)
+        @replay_steps = replay_steps
         @ddqn = ddqn
       end
 
@@ -19,29 +22,28 @@ module DNN
         end
       end
 
+      # Train the model on the minibatches sampled from the memory.
+      # The number of the minibatches is replay_steps, or memory size / batch size when replay_steps is nil.
       def replay
         sum_loss = 0
-        steps = @memory.size / @batch_size
+        steps = @replay_steps || @memory.size / @batch_size
         return nil if steps == 0
-        mem = @memory.shuffle
         @target_model = @model unless @ddqn
         steps.times do
-          x, y = make_batch(mem.shift(@batch_size))
+          batch = @memory.sample(@batch_size)
+          x, y, td_errors = make_batch(batch)
           sum_loss += @model.train_on_batch(x, y)
+          @memory.update_priorities(batch.indexes, td_errors)
           @target_model = @model.copy unless @ddqn
         end
         sum_loss / steps
       end
 
-      def compute_q_value(model, target_model, reward, next_state)
-        if next_state
-          q_values = model.predict1(next_state)
-          next_action = q_values.max_index
-          next_q_value = target_model.predict1(next_state)[next_action]
-          reward + @gamma * next_q_value
-        else
-          reward
-        end
+      def compute_q_values(rewards, next_states, dones)
+        # max_index returns the indexes into the flattened array, so the target Q values are gathered by them.
+        next_actions = @model.predict(next_states).max_index(axis: 1)
+        next_q_values = @target_model.predict(next_states)[next_actions]
+        rewards + (1 - dones) * @gamma * next_q_values
       end
     end
   end
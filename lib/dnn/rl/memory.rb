@@ -1,35 +1,221 @@
 module DNN
   module RL
+    # This class is the replay memory of the transitions.
+    # The transitions are stored in preallocated ring buffers of each column, and the oldest transition is overwritten
+    # when the memory is full. The buffers are allocated when the first transition is added.
     class Memory
+      # Minibatch sampled from the memory.
+      # states, next_states: Numo::SFloat of the shape [batch_size, *state_shape].
+      # actions: Numo::Int32 of the shape [batch_size].
+      # rewards, dones: Numo::SFloat of the shape [batch_size]. done is 1 when the episode is ended.
+      # indexes: Indexes of the sampled transitions in the memory.
+      # weights: Importance sampling weights. It is nil when the transitions are sampled uniformly.
+      Batch = Struct.new(:states, :actions, :rewards, :next_states, :dones, :indexes, :weights) do
+        def size
+          indexes.size
+        end
+      end
+
       attr_reader :max_size
       attr_reader :train_size
+      attr_reader :size
 
+      # @param [Integer] max_size Max number of the transitions.
+      # @param [Integer] train_size Number of the transitions where training can start.
       def initialize(max_size, train_size)
         @max_size = max_size
         @train_size = train_size
-        @memory = []
+        clear
       end
 
-      def add(v)
-        @memory << v
-        @memory.shift if @memory.size > @max_size
-        v
+      # Add the transition.
+      # The transition can also be given as one array [state, action, reward, next_state] in the same form as to_a.
+      # @param [Numo::SFloat | Array] state State before the action.
+      # @param [Integer] action Action.
+      # @param [Float] reward Reward of the action.
+      # @param [Numo::SFloat | Array | NilClass] next_state State after the action. nil when the episode is ended.
+      # @param [Boolean] done Set true when the episode is ended.
+      # @return [Integer] Return the index of the added transition.
+      def add(state, action = nil, reward = nil, next_state = nil, done = nil)
+        state, action, reward, next_state, done = state if action.nil?
+        done = next_state.nil? if done.nil?
+        allocate_buffers(state) unless @states
+        index = @index
+        @states[index, false] = state
+        @actions[index] = action
+        @rewards[index] = reward
+        @next_states[index, false] = next_state ? next_state : 0
+        @dones[index] = done ? 1 : 0
+        @index = (@index + 1) % @max_size
+        @size = [@size + 1, @max_size].min
+        index
       end
 
-      def size
-        @memory.size
+      # Sample the minibatch uniformly with replacement.
+      # @param [Integer] batch_size Number of the transitions to sample.
+      # @return [RL::Memory::Batch] Return the sampled minibatch.
+      def sample(batch_size)
+        raise DNNError, "Memory is empty." if @size == 0
+        gather(Array.new(batch_size) { rand(@size) })
       end
 
-      def shuffle
-        @memory.shuffle
+      # Update the priorities of the sampled transitions. Do nothing in the uniform memory.
+      # @param [Array] indexes Indexes of the transitions.
+      # @param [Numo::SFloat] td_errors TD errors of the transitions.
+      def update_priorities(indexes, td_errors); end
+
+      # Remove all transitions. The allocated buffers are reused.
+      def clear
+        @index = 0
+        @size = 0
       end
 
+      # @return [Array] Return the transitions in the form [state, action, reward, next_state] from the oldest.
       def to_a
-        @memory
+        start = @size < @max_size ? 0 : @index
+        Array.new(@size) do |i|
+          index = (start + i) % @max_size
+          next_state = @dones[index] == 0 ? @next_states[index, false] : nil
+          [@states[index, false], @actions[index], @rewards[index], next_state]
+        end
+      end
+
+      def shuffle
+        to_a.shuffle
       end
 
       def can_train?
-        @memory.size >= @train_size 
+        @size >= @train_size
+      end
+
+      private def allocate_buffers(state)
+        state_shape = Xumo::SFloat.cast(state).shape
+        @states = Xumo::SFloat.zeros(@max_size, *state_shape)
+        @actions = Xumo::Int32.zeros(@max_size)
+        @rewards = Xumo::SFloat.zeros(@max_size)
+        @next_states = Xumo::SFloat.zeros(@max_size, *state_shape)
+        @dones = Xumo::SFloat.zeros(@max_size)
+      end
+
+      private def gather(indexes, weights = nil)
+        Batch.new(@states[indexes, false], @actions[indexes], @rewards[indexes],
+                  @next_states[indexes, false], @dones[indexes], indexes, weights)
+      end
+    end
+
+    # This class is the sum-tree used by the prioritized replay memory.
+    # Each leaf has the priority of the transition and each node has the sum of the children,
+    # so that updating a priority and finding a transition from the prefix sum are O(log n).
+    class SumTree
+      attr_reader :capacity
+
+      # @param [Integer] capacity Number of the leaves.
+      def initialize(capacity)
+        @capacity = capacity
+        @tree = Array.new(2 * capacity - 1, 0.0)
+      end
+
+      # @return [Float] Return the sum of all priorities.
+      def total
+        @tree[0]
+      end
+
+      # @param [Integer] index Index of the leaf.
+      def [](index)
+        @tree[index + @capacity - 1]
+      end
+
+      # @param [Integer] index Index of the leaf.
+      # @param [Float] priority Priority of the leaf.
+      def []=(index, priority)
+        node = index + @capacity - 1
+        @tree[node] = priority
+        # Recompute the sums instead of adding the difference so that the rounding errors are not accumulated.
+        while node > 0
+          node = (node - 1) / 2
+          @tree[node] = @tree[2 * node + 1] + @tree[2 * node + 2]
+        end
+      end
+
+      # Find the leaf where the prefix sum of the priorities exceeds the value.
+      # The node whose sum is 0 is never selected, so that the rounding error of the value near the total
+      # does not select an unfilled leaf.
+      # @param [Float] value Value in [0, total).
+      # @return [Integer] Return the index of the leaf.
+      def find(value)
+        node = 0
+        while node < @capacity - 1
+          left = 2 * node + 1
+          if value < @tree[left] || @tree[left + 1] == 0
+            node = left
+          else
+            value -= @tree[left]
+            node = left + 1
+          end
+        end
+        node - @capacity + 1
+      end
+    end
+
+    # This class is the replay memory that samples the transitions in proportion to the priorities.
+    # The priority of the transition is (|TD error| + epsilon) ** alpha, and the new transition has the max priority.
+    # The importance sampling weights are normalized by the max weight of the minibatch.
+    class PrioritizedMemory < Memory
+      attr_accessor :alpha
+      attr_accessor :beta
+
+      # @param [Integer] max_size Max number of the transitions.
+      # @param [Integer] train_size Number of the transitions where training can start.
+      # @param [Float] alpha Degree of the prioritization. 0 is uniform.
+      # @param [Float] beta Degree of the importance sampling correction. It is annealed to 1.
+      # @param [Float] beta_increment Value added to beta each time the minibatch is sampled.
+      # @param [Float] epsilon Value added to the TD error so that every transition can be sampled.
+      def initialize(max_size, train_size, alpha: 0.6, beta: 0.4, beta_increment: 0.001, epsilon: 1e-6)
+        @alpha = alpha
+        @beta = beta
+        @beta_increment = beta_increment
+        @epsilon = epsilon
+        super(max_size, train_size)
+      end
+
+      def add(state, action = nil, reward = nil, next_state = nil, done = nil)
+        index = super
+        @tree[index] = @max_priority
+        index
+      end
+
+      # Sample the minibatch in proportion to the priorities.
+      # The range of the total priority is split into batch_size segments and one transition is sampled from each.
+      # @param [Integer] batch_size Number of the transitions to sample.
+      # @return [RL::Memory::Batch] Return the sampled minibatch with the importance sampling weights.
+      def sample(batch_size)
+        raise DNNError, "Memory is empty." if @size == 0
+        total = @tree.total
+        segment = total / batch_size
+        indexes = Array.new(batch_size) do |i|
+          value = [segment * (i + rand), total.prev_float].min
+          @tree.find(value)
+        end
+        probs = Xumo::SFloat.cast(indexes.map { |index| @tree[index] }) / total
+        weights = (probs * @size) ** -@beta
+        weights /= weights.max
+        @beta = [@beta + @beta_increment, 1.0].min
+        gather(indexes, weights)
+      end
+
+      def update_priorities(indexes, td_errors)
+        priorities = (td_errors.abs + @epsilon) ** @alpha
+        indexes.each.with_index do |index, i|
+          priority = priorities[i]
+          @tree[index] = priority
+          @max_priority = priority if priority > @max_priority
+        end
+      end
+
+      def clear
+        super
+        @tree = SumTree.new(@max_size)
+        @max_priority = 1.0
       end
     end
   end
@@ -92,3 +92,37 @@ class TestLogger < MiniTest::Unit::TestCase
     assert_equal [1], cbk.get_log(:epoch)
   end
 end
+
+class TestProfile < MiniTest::Unit::TestCase
+  def test_after_train_on_batch
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(10)
+    model << DNN::Layers::Dense.new(4)
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    trainer = DNN::Trainer.new(model)
+    logger = DNN::Callbacks::Logger.new
+    trainer.add_callback(DNN::Callbacks::Profile.new)
+    trainer.add_callback(logger)
+    trainer.fit(Xumo::SFloat.new(8, 10).rand, Xumo::SFloat.new(8, 4).rand, 1, batch_size: 4, verbose: false, need_accuracy: false)
+    [:data_time, :forward_time, :backward_time, :update_time].each do |tag|
+      assert_equal 2, logger.get_log(tag).length
+    end
+    assert_nil DNN::Profiler.current
+  end
+
+  # The profiler is stopped when the training raises.
+  def test_on_train_error
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(10)
+    model << DNN::Layers::Dense.new(4)
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    trainer = DNN::Trainer.new(model)
+    trainer.add_callback(DNN::Callbacks::Profile.new)
+    trainer.add_lambda_callback(:after_train_on_batch) { raise DNN::DNNError, "stop" }
+    assert_raises DNN::DNNError do
+      trainer.fit(Xumo::SFloat.new(8, 10).rand, Xumo::SFloat.new(8, 4).rand, 1, batch_size: 4, verbose: false, need_accuracy: false)
+    end
+    assert_nil DNN::Profiler.current
+    refute trainer.training?
+  end
+end
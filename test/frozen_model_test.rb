@@ -0,0 +1,119 @@
+require "test_helper"
+
+class TestFrozenModel < MiniTest::Unit::TestCase
+  def build_bn(bn, input_shape)
+    bn.build(input_shape)
+    bn.gamma.data = Xumo::SFloat.new(*input_shape).rand(0.5, 1.5)
+    bn.beta.data = Xumo::SFloat.new(*input_shape).rand(-0.5, 0.5)
+    bn.running_mean.data = Xumo::SFloat.new(*input_shape).rand(-0.5, 0.5)
+    bn.running_var.data = Xumo::SFloat.new(*input_shape).rand(0.5, 1.5)
+    bn
+  end
+
+  def build_mlp
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(10)
+    model << DNN::Layers::Dense.new(8)
+    model << build_bn(DNN::Layers::BatchNormalization.new, [8])
+    model << DNN::Layers::ReLU.new
+    model << DNN::Layers::Dense.new(4)
+    model << DNN::Layers::Sigmoid.new
+    model.predict1(Xumo::SFloat.zeros(10))
+    model
+  end
+
+  def build_convnet
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new([8, 8, 3])
+    model << DNN::Layers::Conv2D.new(4, 3, padding: true)
+    model << build_bn(DNN::Layers::BatchNormalization.new, [8, 8, 4])
+    model << DNN::Layers::ReLU.new
+    model << DNN::Layers::MaxPool2D.new(2)
+    model << DNN::Layers::Conv2D.new(2, 1)
+    model << DNN::Layers::Tanh.new
+    model << DNN::Layers::Flatten.new
+    model << DNN::Layers::Dropout.new(0.25)
+    model << DNN::Layers::Dense.new(3)
+    model.predict1(Xumo::SFloat.zeros(8, 8, 3))
+    model
+  end
+
+  def test_predict
+    model = build_mlp
+    x = Xumo::SFloat.new(5, 10).rand(-1, 1)
+    frozen_model = DNN::FrozenModel.new(model)
+    assert_equal model.predict(x).round(4), frozen_model.predict(x).round(4)
+  end
+
+  def test_predict_conv2d
+    model = build_convnet
+    x = Xumo::SFloat.new(2, 8, 8, 3).rand(-1, 1)
+    frozen_model = model.to_frozen_model
+    assert_equal model.predict(x).round(4), frozen_model.predict(x).round(4)
+  end
+
+  def test_predict1
+    model = build_convnet
+    x = Xumo::SFloat.new(8, 8, 3).rand(-1, 1)
+    frozen_model = model.to_frozen_model
+    assert_equal model.predict1(x).round(4), frozen_model.predict1(x).round(4)
+  end
+
+  # It is return the same result when the plan is reused and when the batch size is changed.
+  def test_predict_reuse_plan
+    model = build_mlp
+    x = Xumo::SFloat.new(5, 10).rand(-1, 1)
+    x2 = Xumo::SFloat.new(3, 10).rand(-1, 1)
+    frozen_model = model.to_frozen_model
+    y = frozen_model.predict(x)
+    frozen_model.predict(x2)
+    assert_equal y, frozen_model.predict(x)
+    assert_equal model.predict(x2).round(4), frozen_model.predict(x2).round(4)
+  end
+
+  # A view that starts at an offset of the original narray is predicted from its own rows.
+  def test_predict_view
+    model = build_mlp
+    x = Xumo::SFloat.new(20, 10).rand(-1, 1)
+    frozen_model = model.to_frozen_model
+    assert_equal model.predict(x[10...20, false]).round(4), frozen_model.predict(x[10...20, false]).round(4)
+    assert_equal model.predict1(x[5, false]).round(4), frozen_model.predict1(x[5, false]).round(4)
+  end
+
+  # The inputs are only read, so a frozen narray can be predicted.
+  def test_predict_frozen_input
+    model = build_mlp
+    x = Xumo::SFloat.new(5, 10).rand(-1, 1).freeze
+    frozen_model = model.to_frozen_model
+    assert_equal model.predict(x).round(4), frozen_model.predict(x).round(4)
+  end
+
+  # The learning phase of the layers is restored after the forward pass is recorded.
+  def test_trace_restore_learning_phase
+    model = build_mlp
+    model.set_learning_phase(true)
+    model.to_frozen_model.predict(Xumo::SFloat.new(5, 10).rand(-1, 1))
+    assert model.layers.all?(&:learning_phase?)
+    assert_nil DNN::FrozenModel::Tracer.current
+  end
+
+  # BatchNormalization and activations are fused into Dense.
+  def test_fuse
+    model = build_mlp
+    x = Xumo::SFloat.new(5, 10).rand(-1, 1)
+    frozen_model = model.to_frozen_model
+    frozen_model.predict(x)
+    steps = frozen_model.send(:plan, [x]).steps
+    assert_equal [:dense, :dense], steps.map(&:kind)
+    assert_equal [:relu, :sigmoid], steps.map(&:act)
+  end
+
+  def test_initialize_not_built
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(10)
+    model << DNN::Layers::Dense.new(8)
+    assert_raises DNN::DNNError do
+      DNN::FrozenModel.new(model)
+    end
+  end
+end
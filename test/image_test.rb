@@ -0,0 +1,49 @@
+require "test_helper"
+require "dnn/image"
+require "tmpdir"
+
+class TestImage < MiniTest::Unit::TestCase
+  def write_images(dir, sizes)
+    sizes.map.with_index do |(height, width), i|
+      file_name = "#{dir}/#{i}.png"
+      DNN::Image.write(file_name, Numo::UInt8.new(height, width, 3).rand(256))
+      file_name
+    end
+  end
+
+  # The image of the same size is copied without resizing.
+  def read_resized(file_name, height, width)
+    img = DNN::Image.read(file_name)
+    img.shape[0, 2] == [height, width] ? img : DNN::Image.resize(img, height, width)
+  end
+
+  # The images are decoded on the threads and resized into their slots of the batch.
+  def test_read_batch
+    Dir.mktmpdir do |dir|
+      file_names = write_images(dir, [[8, 8], [12, 6], [4, 16]])
+      imgs = DNN::Image.read_batch(file_names, 8, 8, threads: 2)
+      assert_equal [3, 8, 8, 3], imgs.shape
+      file_names.each.with_index do |file_name, i|
+        assert_equal read_resized(file_name, 8, 8), imgs[i, false]
+      end
+    end
+  end
+
+  # The index of the file that failed to decode is returned and the other images are decoded.
+  def test_load_batch_failed_indexes
+    Dir.mktmpdir do |dir|
+      file_names = write_images(dir, [[8, 8], [12, 6]])
+      broken_file_name = "#{dir}/broken.png"
+      File.write(broken_file_name, "not an image")
+      file_names.insert(1, broken_file_name)
+      bin, failed_indexes = DNN::Stb.load_batch(file_names, 8, 8, DNN::Image::RGB, 2)
+      assert_equal [1], failed_indexes
+      imgs = Numo::UInt8.from_binary(bin).reshape(3, 8, 8, 3)
+      assert_equal read_resized(file_names[0], 8, 8), imgs[0, false]
+      assert_equal read_resized(file_names[2], 8, 8), imgs[2, false]
+      assert_raises DNN::Image::ImageReadError do
+        DNN::Image.read_batch(file_names, 8, 8, threads: 2)
+      end
+    end
+  end
+end
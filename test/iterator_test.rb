@@ -1,4 +1,6 @@
 require "test_helper"
+require "tmpdir"
+require "fileutils"
 
 class TestIterator < MiniTest::Unit::TestCase
   def test_next_batch
@@ -64,3 +66,100 @@ class TestIterator < MiniTest::Unit::TestCase
     assert_equal 3, iter.max_steps(3)
   end
 end
+
+class TestMmapIterator < MiniTest::Unit::TestCase
+  def setup
+    @dir = Dir.mktmpdir
+    @x_file_name = "#{@dir}/x.pt"
+    @y_file_name = "#{@dir}/y.pt"
+    DNN::PackedTensor.write(@x_file_name, Xumo::SFloat.new(10, 2).seq)
+    DNN::PackedTensor.write(@y_file_name, Xumo::Int32.new(10).seq)
+  end
+
+  def teardown
+    FileUtils.remove_entry(@dir)
+  end
+
+  def test_next_batch
+    iter = DNN::MmapIterator.new(@x_file_name, @y_file_name, random: false)
+    iter.next_batch(7)
+    x, y = iter.next_batch(7)
+    assert_equal Xumo::SFloat[[14, 15], [16, 17], [18, 19]], x
+    assert_equal Xumo::Int32[7, 8, 9], y
+    iter.close
+  end
+
+  def test_next_batch2
+    iter = DNN::MmapIterator.new([@x_file_name, @x_file_name], @y_file_name)
+    x, y = iter.next_batch(4)
+    assert_equal [4, 2], x[1].shape
+    assert_equal x[0], x[1]
+    assert_equal Xumo::SFloat.cast(y * 2), x[0][true, 0]
+    iter.close
+  end
+
+  def test_foreach
+    iter = DNN::MmapIterator.new(@x_file_name, @y_file_name, last_round_down: true)
+    cnt = 0
+    iter.foreach(3) do |x_batch, y_batch|
+      cnt += 1
+    end
+    assert_equal 3, cnt
+    iter.close
+  end
+end
+
+class TestPrefetchIterator < MiniTest::Unit::TestCase
+  def test_next_batch
+    x_datas = Xumo::Int32.new(10, 1).seq
+    iter = DNN::PrefetchIterator.new(DNN::Iterator.new(x_datas, x_datas, random: false))
+
+    iter.next_batch(7)
+    x, * = iter.next_batch(7)
+    assert_equal Xumo::SFloat[7, 8, 9], x.flatten
+    assert_equal false, iter.has_next?
+    iter.close
+  end
+
+  def test_next_batch_process
+    skip unless Process.respond_to?(:fork)
+    x_datas = Xumo::Int32.new(10, 1).seq
+    iter = DNN::PrefetchIterator.new(DNN::Iterator.new(x_datas, x_datas, random: false), worker: :process)
+
+    iter.next_batch(7)
+    x, * = iter.next_batch(7)
+    assert_equal Xumo::SFloat[7, 8, 9], x.flatten
+    iter.close
+  end
+
+  def test_foreach
+    x_datas = Xumo::Int32.new(10, 1).seq
+    expected = []
+    DNN::Iterator.new(x_datas, seed: 1, last_round_down: true).foreach(3) do |x_batch|
+      expected << x_batch
+    end
+    iter = DNN::PrefetchIterator.new(DNN::Iterator.new(x_datas, seed: 1, last_round_down: true))
+    batches = []
+    iter.foreach(3) do |x_batch|
+      batches << x_batch
+    end
+    assert_equal expected, batches
+  end
+
+  def test_reset
+    x_datas = Xumo::Int32.new(10, 1).seq
+    iter = DNN::PrefetchIterator.new(DNN::Iterator.new(x_datas, random: false), num_prefetch: 1)
+
+    iter.next_batch(3)
+    iter.reset
+    x, * = iter.next_batch(4)
+    assert_equal Xumo::SFloat[0, 1, 2, 3], x.flatten
+    iter.close
+  end
+
+  def test_max_steps
+    x_datas = Xumo::Int32.new(10, 1).seq
+    iter = DNN::PrefetchIterator.new(DNN::Iterator.new(x_datas, last_round_down: true))
+    assert_equal 3, iter.max_steps(3)
+  end
+end
@@ -83,6 +83,34 @@ class TestConv2D_Utils < MiniTest::Unit::TestCase
     assert_equal expected_img.round(4), img.round(4)
   end
 
+  # im2col padding test.
+  def test_im2col_padding
+    img = Xumo::SFloat.new(2, 5, 4, 3).seq(1)
+    expected_col = im2col(zero_padding(img, [2, 3]), 3, 2, 3, 3, [2, 2])
+    col = im2col(img, 3, 2, 3, 3, [2, 2], [2, 3])
+    assert_equal expected_col.round(4), col.round(4)
+  end
+
+  # col2im padding test.
+  def test_col2im_padding
+    col = Xumo::SFloat.new(2 * 3 * 2, 3 * 3 * 3).seq(1)
+    expected_img = zero_padding_bwd(col2im(col, [2, 7, 7, 3], 3, 2, 3, 3, [2, 2]), [2, 3])
+    img = col2im(col, [2, 5, 4, 3], 3, 2, 3, 3, [2, 2], [2, 3])
+    assert_equal expected_img.round(4), img.round(4)
+  end
+
+  # The native kernels must match the ruby implementation.
+  def test_im2col_native
+    skip "rb_dnn_native is not built." unless DNN.use_native?
+    utils = DNN::Functions::Conv2DFunctionUtils
+    img = Xumo::SFloat.new(2, 6, 5, 3).rand
+    col = Xumo::SFloat.new(2 * 3 * 3, 3 * 2 * 3).rand
+    assert_equal utils.im2col_cpu(img, 3, 3, 3, 2, [2, 2], [2, 1]).round(4),
+                 utils.im2col_native(img, 3, 3, 3, 2, [2, 2], [2, 1]).round(4)
+    assert_equal utils.col2im_cpu(col, [2, 6, 5, 3], 3, 3, 3, 2, [2, 2], [2, 1]).round(4),
+                 utils.col2im_native(col, [2, 6, 5, 3], 3, 3, 3, 2, [2, 2], [2, 1]).round(4)
+  end
+
   def test_zero_padding
     img = Xumo::SFloat.new(1, 2, 4, 4).seq(1).transpose(0, 2, 3, 1)
     expected_img = Xumo::SFloat.cast([[
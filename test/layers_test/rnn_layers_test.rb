@@ -2,6 +2,43 @@ require "test_helper"
 
 include DNN::Layers
 
+# The native whole-sequence kernels must match the cell by cell implementation
+# in the output, the input grad and every parameter grad.
+module NativeRNNTestHelper
+  def assert_native_rnn(layer_class)
+    skip "rb_dnn_native is not built." unless DNN.use_native?
+    [true, false].product([true, false]).each do |return_sequences, use_bias|
+      layer = layer_class.new(4, return_sequences: return_sequences, use_bias: use_bias)
+      layer.build([5, 8])
+      x = Xumo::SFloat.new(2, 5, 8).rand - 0.5
+      dy = Xumo::SFloat.new(*(return_sequences ? [2, 5, 4] : [2, 4])).rand - 0.5
+      native_results = rnn_results(layer, x, dy)
+      begin
+        ENV["RUBY_DNN_USE_NATIVE"] = "DISABLE"
+        results = rnn_results(layer, x, dy)
+      ensure
+        ENV.delete("RUBY_DNN_USE_NATIVE")
+      end
+      assert_equal results.keys, native_results.keys
+      results.each do |key, value|
+        assert_equal value.round(4), native_results[key].round(4),
+                     "#{key} is mismatched. (return_sequences: #{return_sequences}, use_bias: #{use_bias})"
+      end
+    end
+  end
+
+  private def rnn_results(layer, x, dy)
+    params = layer.get_trainable_variables.compact
+    params.each_value { |param| param.grad = Xumo::SFloat[0] }
+    x = DNN::Variable.new(x)
+    y = layer.(x)
+    y.backward(dy)
+    results = { y: y.data, dx: x.grad }
+    params.each { |key, param| results[key] = param.grad }
+    results
+  end
+end
+
 class TestRNN < MiniTest::Unit::TestCase
   def test_initialize
     rnn = RNN.new(64, stateful: true, return_sequences: false,
@@ -193,6 +230,8 @@ end
 
 
 class TestLSTM < MiniTest::Unit::TestCase
+  include NativeRNNTestHelper
+
   def test_from_hash
     hash = {
       class: "DNN::Layers::LSTM",
@@ -235,6 +274,10 @@ class TestLSTM < MiniTest::Unit::TestCase
     assert_equal [1, 16, 64], lstm.forward(x).shape
   end
 
+  def test_native
+    assert_native_rnn(LSTM)
+  end
+
   def test_reset_state
     lstm = LSTM.new(64)
     lstm.build([16, 64])
@@ -311,6 +354,8 @@ end
 
 
 class TestGRU < MiniTest::Unit::TestCase
+  include NativeRNNTestHelper
+
   def test_reset_state
     gru = GRU.new(64)
     gru.build([16, 64])
@@ -362,6 +407,10 @@ class TestGRU < MiniTest::Unit::TestCase
     assert_equal [1, 16, 64], gru.forward(x).shape
   end
 
+  def test_native
+    assert_native_rnn(GRU)
+  end
+
   def test_to_hash
     gru = GRU.new(64, stateful: true, return_sequences: false, use_bias: false,
                   weight_regularizer: DNN::Regularizers::L1.new,
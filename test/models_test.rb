@@ -308,6 +308,22 @@ class TestSequential < MiniTest::Unit::TestCase
     assert_equal model.predict1(x), model2.predict1(x)
   end
 
+  # The narrays are copied, so the in-place updates of the native optimizers do not change params_data.
+  def test_set_all_params_data_copy
+    model = DNN::Models::Sequential.new([InputLayer.new(10), Dense.new(5)])
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    model.predict1(Xumo::SFloat.zeros(10))
+    model2 = DNN::Models::Sequential.new([InputLayer.new(10), Dense.new(5)])
+    model2.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    model2.predict1(Xumo::SFloat.zeros(10))
+
+    params_data = model.get_all_params_data
+    model2.set_all_params_data(params_data)
+    weight = model2.layers[1].weight.data
+    refute_same params_data[1][:weight], weight
+    assert_equal params_data[1][:weight], weight
+  end
+
   def test_to_cpu
     x = Xumo::SFloat[[0, 0]]
     model = Sequential.new
@@ -54,6 +54,60 @@ class TestSGD < MiniTest::Unit::TestCase
     assert_equal(-0.3, dense.weight.data.mean.round(2))
   end
 
+  # The native kernel must match the ruby implementation.
+  def test_update_native
+    skip "rb_dnn_native is not built." unless DNN.use_native? && DNN::Native.respond_to?(:sgd_update)
+    weight = Xumo::SFloat.new(3, 4).rand - 0.5
+    grads = [Xumo::SFloat.new(3, 4).rand - 0.5, Xumo::SFloat[0], Xumo::SFloat.new(3, 4).rand - 0.5]
+    results = [false, true].map do |native|
+      param = DNN::Variable.new(weight.dup)
+      sgd = SGD.new(lr: 0.1, momentum: 0.9)
+      begin
+        ENV["RUBY_DNN_USE_NATIVE"] = "DISABLE" unless native
+        grads.each do |grad|
+          param.grad = grad
+          sgd.update([param])
+        end
+      ensure
+        ENV.delete("RUBY_DNN_USE_NATIVE")
+      end
+      param.data
+    end
+    assert_equal results[0].round(4), results[1].round(4)
+  end
+
+  # The native kernel updates the data in place, so the narray obtained before the update is changed.
+  def test_update_native_in_place
+    skip "rb_dnn_native is not built." unless DNN.use_native? && DNN::Native.respond_to?(:sgd_update)
+    param = DNN::Variable.new(Xumo::SFloat.zeros(3, 4))
+    data = param.data
+    snapshot = data.dup
+    param.grad = Xumo::SFloat.ones(3, 4)
+    SGD.new(lr: 0.1).update([param])
+    assert_same data, param.data
+    assert_equal(-0.1, data.mean.round(2))
+    assert_equal 0, snapshot.mean
+  end
+
+  # Each parameter gets its own zero gradient after the update.
+  def test_update_reset_grad
+    dense = Dense.new(10)
+    dense.build([10])
+    dense.weight.grad = Xumo::SFloat.ones(*dense.weight.data.shape)
+    dense.bias.grad = Xumo::SFloat.ones(*dense.bias.data.shape)
+    SGD.new.update([dense.weight, dense.bias])
+    assert_equal Xumo::SFloat[0], dense.weight.grad
+    refute_same dense.weight.grad, dense.bias.grad
+  end
+
+  # A non-contiguous grad is updated by the ruby implementation.
+  def test_update_native_non_contiguous_grad
+    param = DNN::Variable.new(Xumo::SFloat.zeros(3, 4))
+    param.grad = Xumo::SFloat.ones(4, 3).transpose
+    SGD.new(lr: 0.1).update([param])
+    assert_equal(-0.1, param.data.mean.round(2))
+  end
+
   # It clip norm is works as expected.
   def test_update3
     dense = Dense.new(2, weight_initializer: Zeros.new)
@@ -337,6 +391,28 @@ class TestAdam < MiniTest::Unit::TestCase
     assert_equal(-0.022, dense.weight.data.mean.round(3))
   end
 
+  # The native kernel must match the ruby implementation.
+  def test_update_native
+    skip "rb_dnn_native is not built." unless DNN.use_native? && DNN::Native.respond_to?(:adam_update)
+    weight = Xumo::SFloat.new(3, 4).rand - 0.5
+    grads = Array.new(3) { Xumo::SFloat.new(3, 4).rand - 0.5 }
+    results = [false, true].map do |native|
+      param = DNN::Variable.new(weight.dup)
+      adam = Adam.new(alpha: 0.01, amsgrad: true, clip_norm: 0.5)
+      begin
+        ENV["RUBY_DNN_USE_NATIVE"] = "DISABLE" unless native
+        grads.each do |grad|
+          param.grad = grad
+          adam.update([param])
+        end
+      ensure
+        ENV.delete("RUBY_DNN_USE_NATIVE")
+      end
+      param.data
+    end
+    assert_equal results[0].round(4), results[1].round(4)
+  end
+
   def test_to_hash
     expected_hash = {
       class: "DNN::Optimizers::Adam",
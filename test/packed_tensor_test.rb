@@ -0,0 +1,101 @@
+require "test_helper"
+require "tmpdir"
+require "fileutils"
+
+class TestPackedTensor < MiniTest::Unit::TestCase
+  def setup
+    @dir = Dir.mktmpdir
+    @file_name = "#{@dir}/x.pt"
+  end
+
+  def teardown
+    FileUtils.remove_entry(@dir)
+  end
+
+  def test_write_and_read
+    x = Xumo::SFloat.new(4, 3, 2).seq
+    DNN::PackedTensor.write(@file_name, x, layout: "NHC")
+    assert_equal x, DNN::PackedTensor.read(@file_name)
+  end
+
+  # The data is stored in little-endian regardless of the host byte order.
+  def test_write_little_endian
+    DNN::PackedTensor.write(@file_name, Xumo::SFloat[[1.5, -2]])
+    assert_equal [1.5, -2].pack("e*"), File.binread(@file_name)[-8..-1]
+  end
+
+  def test_convert_byte_order
+    bin = [1, 2].pack("L>*")
+    assert_equal [1, 2].pack("L<*"), DNN::PackedTensor.convert_byte_order(bin, 4, big_endian: true)
+    assert_equal bin, DNN::PackedTensor.convert_byte_order(bin, 4, big_endian: false)
+    assert_equal "\x01\x02".b, DNN::PackedTensor.convert_byte_order("\x01\x02".b, 1, big_endian: true)
+  end
+
+  def test_writer
+    DNN::PackedTensor::Writer.open(@file_name, Xumo::UInt8, [2]) do |writer|
+      writer << Xumo::UInt8[[1, 2]]
+      writer << Xumo::UInt8[[3, 4], [5, 6]]
+    end
+    assert_equal Xumo::UInt8[[1, 2], [3, 4], [5, 6]], DNN::PackedTensor.read(@file_name)
+  end
+
+  def test_writer_shape_error
+    DNN::PackedTensor::Writer.open(@file_name, Xumo::SFloat, [2]) do |writer|
+      assert_raises DNN::DNNShapeError do
+        writer << Xumo::SFloat.zeros(1, 3)
+      end
+    end
+  end
+
+  def test_reader
+    DNN::PackedTensor.write(@file_name, Xumo::Int32.new(5, 2).seq, layout: "NC")
+    reader = DNN::PackedTensor::Reader.new(@file_name)
+    assert_equal [5, 2], reader.shape
+    assert_equal "NC", reader.layout
+    assert_equal Xumo::Int32, reader.narray_class
+    assert_equal Xumo::Int32[[8, 9], [0, 1]], reader.gather([4, 0])
+    reader.close
+  end
+
+  # The batch is gathered into the given narray, so it can be reused every batch.
+  def test_reader_gather_out
+    DNN::PackedTensor.write(@file_name, Xumo::SFloat.new(5, 2).seq)
+    reader = DNN::PackedTensor::Reader.new(@file_name)
+    out = Xumo::SFloat.zeros(2, 2)
+    assert_same out, reader.gather([4, 0], out: out)
+    assert_equal Xumo::SFloat[[8, 9], [0, 1]], out
+    assert_raises DNN::DNNShapeError do
+      reader.gather([1], out: out)
+    end
+    reader.close
+  end
+
+  def test_reader_truncated
+    DNN::PackedTensor.write(@file_name, Xumo::SFloat.new(5, 2).seq)
+    bin = File.binread(@file_name)
+    # The header and the data are truncated respectively.
+    [40, 64 + 4 * 9].each do |size|
+      File.binwrite(@file_name, bin[0, size])
+      assert_raises DNN::PackedTensor::PackedTensorError do
+        DNN::PackedTensor::Reader.new(@file_name)
+      end
+    end
+  end
+
+  def test_mapped_file_initialize_twice
+    skip "rb_dnn_native is not built." unless defined?(DNN::Native::MappedFile)
+    DNN::PackedTensor.write(@file_name, Xumo::SFloat.new(5, 2).seq)
+    mapped_file = DNN::Native::MappedFile.new(@file_name, true)
+    assert_raises IOError do
+      mapped_file.send(:initialize, @file_name, true)
+    end
+    mapped_file.close
+  end
+
+  def test_reader_not_packed_tensor
+    File.binwrite(@file_name, "\0" * 64)
+    assert_raises DNN::PackedTensor::PackedTensorError do
+      DNN::PackedTensor::Reader.new(@file_name)
+    end
+  end
+end
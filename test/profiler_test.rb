@@ -0,0 +1,85 @@
+require "test_helper"
+
+class TestProfiler < MiniTest::Unit::TestCase
+  def build_model
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(10)
+    model << DNN::Layers::Dense.new(4)
+    model << DNN::Layers::ReLU.new
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    model
+  end
+
+  def test_profile
+    model = build_model
+    x = Xumo::SFloat.new(8, 10).rand
+    y = Xumo::SFloat.new(8, 4).rand
+    profiler = DNN::Profiler.new
+    profiler.profile do
+      2.times { model.train_on_batch(x, y) }
+    end
+    dot = profiler.function_stats["DNN::Functions::Dot"]
+    assert_equal 2, dot[:forward].calls
+    assert_equal 2, dot[:backward].calls
+    assert_operator dot[:forward].allocations, :>, 0
+    assert_equal 8 * 4 * 4 * 2, dot[:forward].bytes
+    [:forward, :backward, :update].each do |phase|
+      assert_operator profiler.phase_times[phase], :>, 0
+    end
+    assert_nil DNN::Profiler.current
+  end
+
+  # The forward of the model is measured in the forward phase as well as the loss.
+  def test_train_on_batch_forward_phase
+    model = build_model
+    dense = model.layers[1]
+    def dense.forward(x)
+      sleep 0.02
+      super
+    end
+    profiler = DNN::Profiler.new(functions: false)
+    profiler.profile do
+      model.train_on_batch(Xumo::SFloat.new(8, 10).rand, Xumo::SFloat.new(8, 4).rand)
+    end
+    assert_operator profiler.phase_times[:forward], :>=, 0.02
+  end
+
+  # It is not measured when the profiler is not started.
+  def test_not_started
+    model = build_model
+    profiler = DNN::Profiler.new
+    model.train_on_batch(Xumo::SFloat.new(8, 10).rand, Xumo::SFloat.new(8, 4).rand)
+    assert_equal({}, profiler.function_stats)
+  end
+
+  def test_functions_false
+    model = build_model
+    profiler = DNN::Profiler.new(functions: false)
+    profiler.profile do
+      model.train_on_batch(Xumo::SFloat.new(8, 10).rand, Xumo::SFloat.new(8, 4).rand)
+    end
+    assert_equal({}, profiler.function_stats)
+    assert_operator profiler.phase_times[:update], :>, 0
+  end
+
+  def test_take_step_phase_times
+    profiler = DNN::Profiler.new
+    profiler.profile do
+      DNN::Profiler.phase(:data) { sleep 0.01 }
+    end
+    times = profiler.take_step_phase_times
+    assert_equal DNN::Profiler::PHASES, times.keys
+    assert_operator times[:data], :>=, 0.01
+    assert_equal 0, profiler.take_step_phase_times[:data]
+  end
+
+  def test_to_h
+    profiler = DNN::Profiler.new
+    profiler.profile do
+      DNN::Functions::Sigmoid.(DNN::Tensor.new(Xumo::SFloat.new(2, 3).rand))
+    end
+    hash = profiler.to_h
+    assert_equal 1, hash[:functions]["DNN::Functions::Sigmoid"][:forward][:calls]
+    assert_equal DNN::Profiler::PHASES, hash[:phases].keys
+  end
+end
@@ -0,0 +1,135 @@
+require "test_helper"
+require "dnn/rl"
+
+class TestRLMemory < MiniTest::Unit::TestCase
+  def test_add
+    memory = DNN::RL::Memory.new(3, 2)
+    memory.add([1, 2], 0, 1.0, [3, 4])
+    memory.add([3, 4], 1, 0.5, nil, true)
+    assert_equal 2, memory.size
+    assert_equal [[1, 2], 0, 1.0, [3, 4]], memory.to_a[0].map { |v| v.is_a?(Xumo::NArray) ? v.to_a : v }
+    assert_nil memory.to_a[1][3]
+  end
+
+  # The transition given as one array in the form of to_a is added in the same way.
+  def test_add_array
+    memory = DNN::RL::Memory.new(3, 2)
+    memory.add([[1, 2], 0, 1.0, [3, 4]])
+    memory.add([[3, 4], 1, 0.5, nil])
+    assert_equal 2, memory.size
+    assert_equal [[1, 2], 0, 1.0, [3, 4]], memory.to_a[0].map { |v| v.is_a?(Xumo::NArray) ? v.to_a : v }
+    assert_nil memory.to_a[1][3]
+  end
+
+  # The oldest transition is overwritten when the memory is full.
+  def test_add_overwrite
+    memory = DNN::RL::Memory.new(3, 2)
+    4.times { |i| memory.add([i, i], i, i.to_f, [i + 1, i + 1]) }
+    assert_equal 3, memory.size
+    assert_equal [1, 2, 3], memory.to_a.map { |_, action| action }
+  end
+
+  def test_sample
+    memory = DNN::RL::Memory.new(4, 2)
+    4.times { |i| memory.add([i, i * 2], i, i.to_f, [i + 1, i + 1], i == 3) }
+    batch = memory.sample(8)
+    assert_equal [8, 2], batch.states.shape
+    assert_equal [8, 2], batch.next_states.shape
+    assert_nil batch.weights
+    batch.indexes.each.with_index do |index, i|
+      assert_equal [index, index * 2], batch.states[i, false].to_a
+      assert_equal index, batch.actions[i]
+      assert_equal index.to_f, batch.rewards[i]
+      assert_equal(index == 3 ? 1 : 0, batch.dones[i])
+    end
+  end
+
+  def test_can_train?
+    memory = DNN::RL::Memory.new(4, 2)
+    memory.add([0], 0, 0.0, [1])
+    assert_equal false, memory.can_train?
+    memory.add([1], 0, 0.0, [2])
+    assert_equal true, memory.can_train?
+  end
+end
+
+class TestRLSumTree < MiniTest::Unit::TestCase
+  def test_find
+    tree = DNN::RL::SumTree.new(5)
+    [1.0, 2.0, 0.0, 3.0, 4.0].each.with_index { |priority, i| tree[i] = priority }
+    assert_equal 10.0, tree.total
+    # Each leaf is found as many times as its priority.
+    counts = Array.new(10) { |i| tree.find(i + 0.5) }.each_with_object(Hash.new(0)) { |index, h| h[index] += 1 }
+    assert_equal({ 0 => 1, 1 => 2, 3 => 3, 4 => 4 }, counts.sort.to_h)
+  end
+
+  # The rounding error of the value near the total does not select the unfilled leaf.
+  def test_find_partially_filled
+    tree = DNN::RL::SumTree.new(9)
+    [1.0, 0.581, 0.1 + 0.2, 0.447, 0.554, 1.055].each.with_index { |priority, i| tree[i] = priority }
+    index = tree.find(tree.total.prev_float)
+    assert_operator index, :<, 6
+    assert_operator tree[index], :>, 0
+  end
+end
+
+class TestRLPrioritizedMemory < MiniTest::Unit::TestCase
+  def test_sample
+    memory = DNN::RL::PrioritizedMemory.new(4, 2, alpha: 1.0, beta: 1.0, epsilon: 0.0)
+    4.times { |i| memory.add([i], i, 0.0, [i]) }
+    memory.update_priorities([0, 1, 2, 3], Xumo::SFloat[0, 0, 1, 3])
+    batch = memory.sample(8)
+    counts = batch.indexes.each_with_object(Hash.new(0)) { |index, h| h[index] += 1 }
+    assert_equal 0, counts[0]
+    assert_equal 0, counts[1]
+    assert_equal 2, counts[2]
+    assert_equal 6, counts[3]
+    # The transition sampled more is weighted less.
+    assert_in_delta 1.0 / 3, batch.weights[batch.indexes.index(3)], 1e-6
+    assert_in_delta 1.0, batch.weights[batch.indexes.index(2)], 1e-6
+  end
+
+  # The weights of the partially filled memory are finite.
+  def test_sample_partially_filled
+    memory = DNN::RL::PrioritizedMemory.new(9, 2, alpha: 1.0, epsilon: 0.0)
+    6.times { |i| memory.add([i], i, 0.0, [i]) }
+    memory.update_priorities([0, 1, 2, 3, 4, 5], Xumo::SFloat[1.0, 0.581, 0.1 + 0.2, 0.447, 0.554, 1.055])
+    100.times do
+      batch = memory.sample(4)
+      assert batch.indexes.all? { |index| index < 6 }
+      assert batch.weights.to_a.all?(&:finite?)
+    end
+  end
+
+  def test_add_max_priority
+    memory = DNN::RL::PrioritizedMemory.new(4, 2, alpha: 1.0, epsilon: 0.0)
+    memory.add([0], 0, 0.0, [0])
+    memory.update_priorities([0], Xumo::SFloat[5])
+    memory.add([1], 1, 0.0, [1])
+    batch = memory.sample(2)
+    assert_equal [0, 1], batch.indexes
+  end
+end
+
+class TestDQNAgent < MiniTest::Unit::TestCase
+  def test_make_batch
+    model = DNN::Models::Sequential.new
+    model << DNN::Layers::InputLayer.new(2)
+    model << DNN::Layers::Dense.new(3)
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    agent = DNN::RL::DQNAgent.new(model, DNN::RL::Env.new(2, 3, 10), gamma: 0.5, ddqn: false)
+    agent.instance_variable_set(:@target_model, model)
+    memory = DNN::RL::Memory.new(2, 2)
+    memory.add(Xumo::SFloat[1, 2], 2, 1.0, Xumo::SFloat[3, 4])
+    memory.add(Xumo::SFloat[3, 4], 0, 2.0, nil, true)
+    batch = memory.sample(4)
+    x, y, td_errors = agent.make_batch(batch)
+    batch.indexes.each.with_index do |index, i|
+      q_values = model.predict1(x[i, false])
+      target = index == 0 ? 1.0 + 0.5 * model.predict1(Xumo::SFloat[3, 4]).max : 2.0
+      action = index == 0 ? 2 : 0
+      assert_in_delta target, y[i, action], 1e-5
+      assert_in_delta target - q_values[action], td_errors[i], 1e-5
+    end
+  end
+end
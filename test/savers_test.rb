@@ -60,3 +60,116 @@ class TestJSONSaver < MiniTest::Unit::TestCase
     assert_equal model.predict1(x), model2.predict1(x)
   end
 end
+
+class TestBinarySaver < MiniTest::Unit::TestCase
+  def build_model(layers = [DNN::Layers::Dense.new(4), DNN::Layers::Dense.new(1)], input_shape = [10])
+    model = DNN::Models::Sequential.new([DNN::Layers::InputLayer.new(input_shape), *layers])
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    model.predict1(Xumo::SFloat.zeros(*input_shape))
+    model
+  end
+
+  def assert_variables_equal(model, model2)
+    model.layers.zip(model2.layers) do |layer, layer2|
+      layer.get_variables.each do |key, param|
+        next unless param.is_a?(DNN::Variable)
+        assert_equal param.data, layer2.get_variables[key].data
+      end
+    end
+  end
+
+  # It is result of load binary checkpoint is as expected.
+  def test_dump_bin
+    model = build_model
+    model2 = build_model
+
+    saver = DNN::Savers::BinarySaver.new(model)
+    bin = saver.send(:dump_bin)
+    loader = DNN::Loaders::BinaryLoader.new(model2)
+    loader.send(:load_bin, bin)
+
+    x = Xumo::SFloat.new(10).rand
+    assert_equal model.predict1(x), model2.predict1(x)
+  end
+
+  # The bias of use_bias: false is nil, so it is neither saved nor required.
+  def test_dump_bin_use_bias_false
+    model = build_model([DNN::Layers::Dense.new(4, use_bias: false)])
+    model2 = build_model([DNN::Layers::Dense.new(4, use_bias: false)])
+
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+    DNN::Loaders::BinaryLoader.new(model2).send(:load_bin, bin)
+
+    assert_variables_equal model, model2
+  end
+
+  # The recurrent states are not variables, so they are neither saved nor required.
+  def test_dump_bin_rnn
+    [false, true].each do |stateful|
+      model = build_model([DNN::Layers::LSTM.new(4, stateful: stateful)], [5, 8])
+      model2 = build_model([DNN::Layers::LSTM.new(4, stateful: stateful)], [5, 8])
+
+      bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+      DNN::Loaders::BinaryLoader.new(model2).send(:load_bin, bin)
+
+      assert_variables_equal model, model2
+    end
+  end
+
+  # It is load the tensors without verifying the checksum.
+  def test_load_bin_without_verify
+    model = build_model
+    model2 = build_model
+
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+    DNN::Loaders::BinaryLoader.new(model2, verify: false).send(:load_bin, bin)
+
+    assert_variables_equal model, model2
+  end
+
+  # It is load only the specified layers.
+  def test_load_bin_layers
+    model = build_model
+    model2 = build_model
+    weight = model2.layers[2].weight.data
+
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+    DNN::Loaders::BinaryLoader.new(model2, layers: [model2.layers[1]]).send(:load_bin, bin)
+
+    assert_equal model.layers[1].weight.data, model2.layers[1].weight.data
+    assert_equal weight, model2.layers[2].weight.data
+  end
+
+  # It is raise an error when the layer to load is not in the model.
+  def test_load_bin_layers_not_found
+    model = build_model
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+
+    assert_raises DNN::DNNError do
+      DNN::Loaders::BinaryLoader.new(build_model, layers: [DNN::Layers::Dense.new(4)]).send(:load_bin, bin)
+    end
+  end
+
+  # It is raise an error when the checkpoint has no variables of a layer of the model.
+  def test_load_bin_missing_layer
+    model = DNN::Models::Sequential.new([DNN::Layers::InputLayer.new(10), DNN::Layers::Dense.new(4)])
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    model.predict1(Xumo::SFloat.zeros(10))
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+
+    assert_raises DNN::DNNError do
+      DNN::Loaders::BinaryLoader.new(build_model).send(:load_bin, bin)
+    end
+  end
+
+  # It is raise an error when the checksum is mismatch.
+  def test_load_bin_checksum
+    model = build_model
+    bin = DNN::Savers::BinarySaver.new(model).send(:dump_bin)
+    bin[DNN::Savers::BinarySaver::ALIGNMENT] = (bin[DNN::Savers::BinarySaver::ALIGNMENT].ord ^ 1).chr
+
+    assert_raises DNN::DNNError do
+      DNN::Loaders::BinaryLoader.new(build_model).send(:load_bin, bin)
+    end
+  end
+end
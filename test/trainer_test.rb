@@ -14,4 +14,16 @@ class TestTrainer < MiniTest::Unit::TestCase
     trainer = DNN::Trainer.new(DNN::Models::Model.new)
     assert_equal str_met, trainer.send(:metrics_to_str, met)
   end
+
+  # after_train is called when the training ends without the test data.
+  def test_fit_after_train
+    model = DNN::Models::Sequential.new([DNN::Layers::InputLayer.new(2), DNN::Layers::Dense.new(1)])
+    model.setup(DNN::Optimizers::SGD.new, DNN::Losses::MeanSquaredError.new)
+    trainer = DNN::Trainer.new(model)
+    num_calls = 0
+    trainer.add_lambda_callback(:after_train) { num_calls += 1 }
+    trainer.fit(Xumo::SFloat.new(4, 2).rand, Xumo::SFloat.new(4, 1).rand, 2, batch_size: 2, verbose: false)
+    assert_equal 1, num_calls
+    refute trainer.training?
+  end
 end